@@ -0,0 +1,33 @@
+#include "allocation-counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<std::uint64_t> allocations {0};
+} // namespace
+
+namespace Askpass {
+    std::uint64_t allocation_count() noexcept {
+        return allocations.load(std::memory_order_relaxed);
+    }
+} // namespace Askpass
+
+// Replaces the global operator new for the whole benchmark executable. It lives in its own
+// translation unit, so the compiler never sees it paired with the free() below.
+void *operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size != 0 ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstdint>
+
+#include <benchmark/benchmark.h>
+
+namespace Askpass {
+    // Number of operator new calls so far
+    std::uint64_t allocation_count() noexcept;
+
+    // Reports the allocations per iteration of a benchmark next to its time
+    class AllocationCounter {
+        benchmark::State &m_state;
+        std::uint64_t m_start;
+
+    public:
+        explicit AllocationCounter(benchmark::State &state) : m_state(state), m_start(allocation_count()) {}
+
+        AllocationCounter(const AllocationCounter &) = delete;
+
+        ~AllocationCounter() {
+            m_state.counters["allocations"]
+                = benchmark::Counter(double(allocation_count() - m_start), benchmark::Counter::kAvgIterations);
+        }
+    };
+} // namespace Askpass
+
+#endif
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <benchmark/benchmark.h>
+
+#include "allocation-counter.h"
+#include "fixtures.h"
+#include "ask-file-parser.h"
+#include "request-queue.h"
+#include "systemd-askpass-context.h"
+
+namespace {
+    // As written by systemd-ask-password
+    constexpr std::string_view SmallAskFile = "[Ask]\n"
+                                              "PID=1\n"
+                                              "Socket=/run/systemd/ask-password/sck.0123456789abcdef\n"
+                                              "AcceptCached=1\n"
+                                              "Echo=0\n"
+                                              "NotAfter=0\n"
+                                              "Id=cryptsetup:/dev/disk/by-uuid/00000000-0000-0000-0000-000000000000\n"
+                                              "Message=Please enter passphrase for disk root:\n"
+                                              "Icon=drive-harddisk\n";
+
+    constexpr std::string_view MalformedAskFile = "[Ask]\n"
+                                                  "PID=1\n"
+                                                  "Socket=/run/systemd/ask-password/sck.0123456789abcdef\n"
+                                                  "NotAfter=soon\n";
+
+    // Comments and unknown sections ahead of the request, which the parser has to skip
+    std::string make_large_ask_file(std::size_t padding_lines) {
+        std::string result;
+        for (std::size_t i = 0; i < padding_lines; ++i) {
+            result += i % 2 == 0 ? "# padding comment of an unusually large ask file\n" : "[Other]\nKey=Value\n";
+        }
+        result += SmallAskFile;
+        return result;
+    }
+
+    void BM_ParseSmallAskFile(benchmark::State &state) {
+        Askpass::AllocationCounter allocations {state};
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(Askpass::parse_ask_file(SmallAskFile));
+        }
+        state.SetBytesProcessed(state.iterations() * SmallAskFile.size());
+    }
+    BENCHMARK(BM_ParseSmallAskFile);
+
+    void BM_ParseLargeAskFile(benchmark::State &state) {
+        const std::string ask_file = make_large_ask_file(state.range(0));
+        Askpass::AllocationCounter allocations {state};
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(Askpass::parse_ask_file(ask_file));
+        }
+        state.SetBytesProcessed(state.iterations() * ask_file.size());
+    }
+    BENCHMARK(BM_ParseLargeAskFile)->Arg(64)->Arg(1024);
+
+    void BM_ParseMalformedAskFile(benchmark::State &state) {
+        Askpass::AllocationCounter allocations {state};
+        for (auto _ : state) {
+            try {
+                benchmark::DoNotOptimize(Askpass::parse_ask_file(MalformedAskFile));
+            } catch (const Askpass::AskFileParseError &ex) {
+                benchmark::DoNotOptimize(ex.line());
+            }
+        }
+    }
+    BENCHMARK(BM_ParseMalformedAskFile);
+
+    // Parsing plus connecting the answer socket, everything after the file was read
+    void BM_ContextFromAskFile(benchmark::State &state) {
+        Askpass::AnswerSocket answer_socket {};
+        const std::string ask_file = Askpass::make_ask_file(answer_socket.path(), "Password:");
+        Askpass::AllocationCounter allocations {state};
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(Askpass::SystemdAskpassContext::from_askpass_file(ask_file));
+        }
+    }
+    BENCHMARK(BM_ContextFromAskFile);
+
+    // The keys and values the model queues, without their contexts
+    using BenchmarkQueue = Askpass::RequestQueue<std::string, std::uint64_t>;
+
+    std::string make_key(std::int64_t index) {
+        return "ask." + std::to_string(index);
+    }
+
+    void BM_QueuePushPop(benchmark::State &state) {
+        const std::int64_t size = state.range(0);
+        Askpass::AllocationCounter allocations {state};
+        for (auto _ : state) {
+            BenchmarkQueue queue {Askpass::QueuePolicy::EarliestDeadline};
+            // Deadlines out of order, every fourth request doesn't expire
+            for (std::int64_t i = 0; i < size; ++i) {
+                queue.push(make_key(i), i, i % 4 == 0 ? 0 : (i * 7919) % size + 1);
+            }
+            while (!queue.empty()) {
+                benchmark::DoNotOptimize(queue.pop());
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * size);
+    }
+    BENCHMARK(BM_QueuePushPop)->Range(16, 16384);
+
+    void BM_QueueRemove(benchmark::State &state) {
+        const std::int64_t size = state.range(0);
+        Askpass::AllocationCounter allocations {state};
+        for (auto _ : state) {
+            state.PauseTiming();
+            BenchmarkQueue queue {Askpass::QueuePolicy::Fifo};
+            for (std::int64_t i = 0; i < size; ++i) {
+                queue.push(make_key(i), i, i + 1);
+            }
+            state.ResumeTiming();
+            // Deleted ask files leave in no particular order
+            for (std::int64_t i = 0; i < size; ++i) {
+                queue.remove(make_key((i * 7919) % size));
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * size);
+    }
+    BENCHMARK(BM_QueueRemove)->Range(16, 16384);
+} // namespace
+
+BENCHMARK_MAIN();
\ No newline at end of file
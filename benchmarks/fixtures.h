@@ -0,0 +1,103 @@
+#ifndef FIXTURES_H
+#define FIXTURES_H
+
+#include <array>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "unique_fd.h"
+
+namespace Askpass {
+    // A directory for ask files, removed with everything in it
+    class AskDirectory {
+        std::filesystem::path m_path;
+        std::shared_ptr<const wrapper::unique_fd> m_fd;
+
+        static std::filesystem::path make_directory() {
+            std::string path = std::filesystem::temp_directory_path() / "askpass-benchmark.XXXXXX";
+            if (mkdtemp(path.data()) == nullptr) {
+                std::abort();
+            }
+            return path;
+        }
+
+    public:
+        AskDirectory() : m_path(make_directory()) {
+            m_fd = std::make_shared<const wrapper::unique_fd>(open(m_path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC));
+        }
+
+        AskDirectory(const AskDirectory &) = delete;
+
+        ~AskDirectory() { std::filesystem::remove_all(m_path); }
+
+        const std::filesystem::path &path() const noexcept { return m_path; }
+
+        // An O_PATH fd, as the directory monitor hands it to the model
+        const std::shared_ptr<const wrapper::unique_fd> &fd() const noexcept { return m_fd; }
+
+        void write_file(const std::string &name, std::string_view contents) const {
+            wrapper::unique_fd fd {openat(m_fd->get(), name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)};
+            if (fd.get() < 0 || write(fd.get(), contents.data(), contents.size()) != ssize_t(contents.size())) {
+                std::abort();
+            }
+        }
+
+        void remove_file(const std::string &name) const { unlinkat(m_fd->get(), name.c_str(), 0); }
+    };
+
+    // A bound datagram socket, like the one systemd-ask-password waits on. Answers sent to it are
+    // only read by drain().
+    class AnswerSocket {
+        std::filesystem::path m_path;
+        wrapper::unique_fd m_socket;
+
+    public:
+        explicit AnswerSocket(std::filesystem::path path) :
+                m_path(std::move(path)), m_socket(socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0)) {
+            sockaddr_un addr {};
+            addr.sun_family = AF_UNIX;
+            m_path.native().copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+            unlink(m_path.c_str());
+            if (bind(m_socket.get(), reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) < 0) {
+                std::abort();
+            }
+        }
+
+        AnswerSocket() :
+                AnswerSocket(std::filesystem::temp_directory_path() / ("askpass-benchmark." + std::to_string(getpid()))) {}
+
+        AnswerSocket(const AnswerSocket &) = delete;
+
+        ~AnswerSocket() { unlink(m_path.c_str()); }
+
+        const std::filesystem::path &path() const noexcept { return m_path; }
+
+        // Discards the answers sent so far, so writing them never blocks
+        void drain() const {
+            std::array<char, 4096> buffer;
+            while (recv(m_socket.get(), buffer.data(), buffer.size(), MSG_DONTWAIT) >= 0) {}
+        }
+    };
+
+    // An ask file of the calling process, padded with comments to at least size bytes
+    inline std::string make_ask_file(
+        const std::filesystem::path &socket, std::string_view message, std::size_t size = 0, time_t not_after = 0) {
+        std::string result = "[Ask]\nPID=" + std::to_string(getpid()) + "\nSocket=" + socket.native() + "\nMessage=";
+        result.append(message).append("\nNotAfter=").append(std::to_string(not_after)).append("\n");
+        while (result.size() < size) {
+            result += "# padding\n";
+        }
+        return result;
+    }
+} // namespace Askpass
+
+#endif
\ No newline at end of file
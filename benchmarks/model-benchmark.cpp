@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <glibmm.h>
+
+#include <sys/resource.h>
+
+#include "fixtures.h"
+#include "headless-ui.h"
+#include "model.h"
+
+namespace {
+    // Headless time between two answers, so requests expire while they are queued
+    constexpr time_t AnswerDelay = 1000;
+    // Files and sockets besides the connected answer socket of every queued request
+    constexpr rlim_t ReservedFiles = 64;
+
+    bool raise_file_limit(rlim_t needed) {
+        rlimit limit {};
+        if (getrlimit(RLIMIT_NOFILE, &limit) < 0 || limit.rlim_max < needed) {
+            return false;
+        }
+        limit.rlim_cur = limit.rlim_max;
+        return setrlimit(RLIMIT_NOFILE, &limit) == 0;
+    }
+
+    double percentile(std::vector<double> &values, double fraction) {
+        if (values.empty()) {
+            return 0;
+        }
+        auto nth = values.begin() + static_cast<std::ptrdiff_t>(fraction * (values.size() - 1));
+        std::nth_element(values.begin(), nth, values.end());
+        return *nth;
+    }
+
+    // Feeds range(0) ask files through Askpass::Model without a display. A quarter of them never
+    // expire, the others have deadlines spread over the time it takes to answer all of them, and
+    // every tenth answer a random file is deleted. Reports the wall time from answering a window
+    // until the next one is shown.
+    void BM_ModelScale(benchmark::State &state) {
+        const auto request_count = static_cast<std::size_t>(state.range(0));
+        if (!raise_file_limit(request_count + ReservedFiles)) {
+            state.SkipWithError("RLIMIT_NOFILE is too low for this many queued requests");
+            return;
+        }
+
+        std::mt19937 random {42};
+        std::vector<double> latencies {};
+        std::size_t windows = 0;
+        for (auto _ : state) {
+            state.PauseTiming();
+            Askpass::AskDirectory directory {};
+            Askpass::AnswerSocket answer_socket {directory.path() / "sck.benchmark"};
+            Askpass::HeadlessUi ui {};
+            Askpass::Model model {ui};
+
+            const time_t last_deadline = ui.now() + time_t(request_count) * AnswerDelay;
+            std::uniform_int_distribution<time_t> deadline {ui.now() + 1, last_deadline};
+            std::vector<std::string> names {};
+            for (std::size_t i = 0; i < request_count; ++i) {
+                names.push_back("ask." + std::to_string(i));
+                time_t not_after = i % 4 == 0 ? 0 : deadline(random);
+                directory.write_file(names.back(),
+                    Askpass::make_ask_file(answer_socket.path(), "Password " + std::to_string(i), 0, not_after));
+            }
+            state.ResumeTiming();
+
+            for (std::size_t i = 0; i < request_count; ++i) {
+                model.on_file_created(Askpass::AskpassFile {directory.fd(), names[i], i + 1});
+            }
+            model.on_file_events_ended();
+            ui.dispatch_until([&model]() { return !model.is_prefetching(); });
+
+            std::uniform_int_distribution<std::size_t> file {0, request_count - 1};
+            while (ui.has_window()) {
+                const auto begin = std::chrono::steady_clock::now();
+                ui.answer("password");
+                ui.dispatch();
+                const std::chrono::duration<double, std::micro> latency = std::chrono::steady_clock::now() - begin;
+                latencies.push_back(latency.count());
+                answer_socket.drain();
+                if (++windows % 10 == 0) {
+                    const std::string &name = names[file(random)];
+                    directory.remove_file(name);
+                    model.on_file_deleted(Askpass::AskpassFile {directory.fd(), name});
+                }
+                ui.advance(AnswerDelay);
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * request_count);
+        state.counters["windows"] = benchmark::Counter(double(windows), benchmark::Counter::kAvgIterations);
+        state.counters["p50_us"]  = percentile(latencies, 0.5);
+        state.counters["p99_us"]  = percentile(latencies, 0.99);
+        state.counters["max_us"]  = latencies.empty() ? 0 : *std::max_element(latencies.begin(), latencies.end());
+    }
+    BENCHMARK(BM_ModelScale)->Arg(10000)->Arg(16000)->Unit(benchmark::kMillisecond)->Iterations(3);
+} // namespace
+
+int main(int argc, char **argv) {
+    Glib::init();
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
\ No newline at end of file
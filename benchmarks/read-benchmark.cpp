@@ -0,0 +1,71 @@
+#include <memory>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <giomm.h>
+
+#include "allocation-counter.h"
+#include "fixtures.h"
+#include "macros.h"
+#include "model.h"
+
+namespace {
+    constexpr char AskFileName[] = "ask.benchmark";
+
+    // The read path before ask files were read with openat: GIO opens the file, queries its
+    // size and reads it into a string, which is then parsed
+    std::string read_gio_file(Gio::File &file) {
+        auto input_stream = file.read();
+        auto size_hint    = file.query_info(G_FILE_ATTRIBUTE_STANDARD_SIZE)->get_size();
+
+        std::string buffer {};
+        buffer.resize(size_hint + 1);
+
+        gssize bytes_read = input_stream->read(buffer.data(), buffer.size());
+        abort_if(bytes_read < 0);
+
+        constexpr size_t SizeIncreaseOnReadNotEOF = 256;
+        while (gsize(bytes_read) == buffer.size()) {
+            buffer.resize(buffer.size() + SizeIncreaseOnReadNotEOF);
+            gssize read = input_stream->read(buffer.data() + bytes_read, SizeIncreaseOnReadNotEOF);
+            abort_if(read < 0);
+            bytes_read += read;
+        }
+
+        buffer.resize(bytes_read);
+        return buffer;
+    }
+
+    // Both paths end in a connected context, so the difference is the cost of reading
+    void BM_ReadAskFileGio(benchmark::State &state) {
+        Askpass::AskDirectory directory {};
+        Askpass::AnswerSocket answer_socket {directory.path() / "sck.benchmark"};
+        directory.write_file(AskFileName, Askpass::make_ask_file(answer_socket.path(), "Password:", state.range(0)));
+        auto file = Gio::File::create_for_path(directory.path() / AskFileName);
+        Askpass::AllocationCounter allocations {state};
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(Askpass::SystemdAskpassContext::from_askpass_file(read_gio_file(*file)));
+        }
+    }
+    BENCHMARK(BM_ReadAskFileGio)->Arg(0)->Arg(16384);
+
+    void BM_ReadAskFileOpenat(benchmark::State &state) {
+        Askpass::AskDirectory directory {};
+        Askpass::AnswerSocket answer_socket {directory.path() / "sck.benchmark"};
+        directory.write_file(AskFileName, Askpass::make_ask_file(answer_socket.path(), "Password:", state.range(0)));
+        const Askpass::AskpassFile file {directory.fd(), AskFileName};
+        Askpass::AllocationCounter allocations {state};
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(Askpass::detail::read_askpass_file(file));
+        }
+    }
+    BENCHMARK(BM_ReadAskFileOpenat)->Arg(0)->Arg(16384);
+} // namespace
+
+int main(int argc, char **argv) {
+    Gio::init();
+    benchmark::Initialize(&argc, argv);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
\ No newline at end of file
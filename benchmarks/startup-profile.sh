@@ -0,0 +1,28 @@
+#!/bin/sh
+# Starts each prompt repeatedly with WAYLAND_ASKPASS_PROFILE=cancel, which cancels it once the
+# first frame was painted, and prints the median time to that frame and the resident set then.
+# Needs a running session: startup-profile.sh RUNS EXECUTABLE...
+set -eu
+
+runs=$1
+shift
+
+median() {
+    sort -n | awk '{ values[NR] = $1 } END { print values[int((NR + 1) / 2)] }'
+}
+
+for executable in "$@"; do
+    samples=$(mktemp)
+    for _ in $(seq "$runs"); do
+        WAYLAND_ASKPASS_PROFILE=cancel WAYLAND_ASKPASS_NON_UNIQUE=1 "$executable" "startup profile" 2>&1 >/dev/null |
+            sed -n 's/^askpass-profile phase=first_frame .*since_exec_us=\([0-9]*\) rss_kb=\([0-9]*\)$/\1 \2/p' \
+            >>"$samples" || true
+    done
+    if [ ! -s "$samples" ]; then
+        echo "$executable: no first frame was painted" >&2
+    else
+        echo "$executable: first_frame_us=$(cut -d' ' -f1 "$samples" | median)" \
+            "rss_kb=$(cut -d' ' -f2 "$samples" | median) runs=$(wc -l <"$samples")"
+    fi
+    rm -f "$samples"
+done
\ No newline at end of file
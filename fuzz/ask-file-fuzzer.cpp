@@ -0,0 +1,25 @@
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "ask-file-parser.h"
+
+// Any input either parses or throws AskFileParseError, which must not leave the parser
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size) {
+    std::string_view buffer {reinterpret_cast<const char *>(data), size};
+    try {
+        Askpass::AskFile ask_file = Askpass::parse_ask_file(buffer);
+        // The views have to point into the buffer. Message has a default which doesn't.
+        for (std::string_view value : {ask_file.id, ask_file.icon, ask_file.socket}) {
+            if (!value.empty() && (value.data() < buffer.data() || value.data() + value.size() > buffer.data() + size)) {
+                __builtin_trap();
+            }
+        }
+    } catch (const Askpass::AskFileParseError &) {
+    }
+    try {
+        Askpass::parse_ask_request(buffer);
+    } catch (const Askpass::AskFileParseError &) {
+    }
+    return 0;
+}
\ No newline at end of file
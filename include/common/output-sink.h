@@ -0,0 +1,47 @@
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <initializer_list>
+#include <memory>
+#include <string_view>
+
+#include <glibmm.h>
+#include <sigc++/signal.h>
+
+#include "secure-buffer.h"
+#include "unique_fd.h"
+
+namespace Askpass {
+    // Writes one answer without blocking the main loop. Whatever doesn't fit right away is kept in a
+    // SecureBuffer and written from an fd source once the fd becomes writable, so the caller's data
+    // may go away as soon as write() returns. signal_done() is emitted exactly once, with 0 or the
+    // errno of the failed write, possibly from inside write().
+    class OutputSink : public sigc::trackable {
+        // A duplicate of the fd, so it outlives the caller's while the write is pending
+        wrapper::unique_fd m_fd {};
+        int m_restore_flags {-1};
+        std::unique_ptr<SecureBuffer> m_pending {};
+        sigc::scoped_connection m_io_watch {};
+        sigc::signal<void(int)> m_signal_done {};
+        bool m_writing {false};
+
+        void set_non_blocking(int fd);
+        void restore_flags(int fd);
+        bool on_writable(Glib::IOCondition);
+        void finish(int fd, int error);
+
+    public:
+        OutputSink() = default;
+
+        OutputSink(const OutputSink &) = delete;
+
+        // Writes the concatenation of parts to fd
+        void write(int fd, std::initializer_list<std::string_view> parts);
+
+        bool is_writing() const noexcept { return m_writing; }
+
+        sigc::signal<void(int)> signal_done() noexcept { return m_signal_done; }
+    };
+} // namespace Askpass
+
+#endif
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <string_view>
+
+#include <gtkmm.h>
+
+// The X11 module exports this entry point. It is called once the window is realized.
+extern "C" {
+using askpass_platform_setup_func_t = void(GtkWindow *window);
+
+askpass_platform_setup_func_t askpass_platform_setup;
+}
+
+#ifdef GDK_WINDOWING_WAYLAND
+// Linked in rather than loaded, as gtk4-layer-shell must be loaded before libwayland-client
+void platform_setup_wayland(Gtk::Window &window);
+#endif
+
+namespace Askpass {
+    // Loads the module for platform ("x11") on first use and runs its setup for window.
+    // Exits with InvalidPlatform if the module cannot be loaded.
+    void platform_setup(std::string_view platform, Gtk::Window &window);
+} // namespace Askpass
+
+#endif
\ No newline at end of file
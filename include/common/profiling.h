@@ -0,0 +1,16 @@
+#ifndef PROFILING_H
+#define PROFILING_H
+
+namespace Askpass {
+    // WAYLAND_ASKPASS_PROFILE=1 prints a line to stderr whenever a startup phase is reached,
+    // WAYLAND_ASKPASS_PROFILE=cancel also cancels the prompt once its first frame was painted
+    bool is_profiling_enabled();
+
+    bool is_cancel_after_first_frame_enabled();
+
+    // Prints "askpass-profile phase=<phase> monotonic_us=<CLOCK_MONOTONIC> since_exec_us=<delta>
+    // rss_kb=<resident set>"
+    void mark_phase(const char *phase);
+} // namespace Askpass
+
+#endif
\ No newline at end of file
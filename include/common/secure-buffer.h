@@ -0,0 +1,48 @@
+#ifndef SECURE_BUFFER_H
+#define SECURE_BUFFER_H
+
+#include <cstddef>
+#include <string_view>
+
+namespace Askpass {
+    // Room for one answer, including the terminating NUL
+    inline constexpr std::size_t SecretCapacity = 4096;
+
+    // Fixed size memory for secrets. It is locked into RAM, left out of core dumps and zeroed
+    // whenever bytes are released. The contents are always NUL terminated.
+    class SecureBuffer {
+        char *m_data;
+        std::size_t m_mapping_size;
+        std::size_t m_size {0};
+
+    public:
+        explicit SecureBuffer(std::size_t capacity = SecretCapacity);
+
+        SecureBuffer(const SecureBuffer &) = delete;
+
+        ~SecureBuffer();
+
+        char *data() noexcept { return m_data; }
+
+        const char *data() const noexcept { return m_data; }
+
+        std::size_t size() const noexcept { return m_size; }
+
+        // Usable bytes, without the terminating NUL
+        std::size_t capacity() const noexcept { return m_mapping_size - 1; }
+
+        std::string_view view() const noexcept { return {m_data, m_size}; }
+
+        // Inserts bytes at offset, returns false without changing anything if they don't fit
+        bool insert(std::size_t offset, std::string_view bytes) noexcept;
+
+        void erase(std::size_t offset, std::size_t count) noexcept;
+
+        // Grows into bytes written through data(), or shrinks and zeroes the released tail
+        void resize(std::size_t size) noexcept;
+
+        void clear() noexcept { resize(0); }
+    };
+} // namespace Askpass
+
+#endif
\ No newline at end of file
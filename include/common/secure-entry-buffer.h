@@ -0,0 +1,12 @@
+#ifndef SECURE_ENTRY_BUFFER_H
+#define SECURE_ENTRY_BUFFER_H
+
+#include <gtkmm.h>
+
+namespace Askpass {
+    // Replaces the text buffer of entry with one kept in a SecureBuffer. Text read through the
+    // entry then points into locked memory, and edits never reallocate it.
+    void use_secure_entry_buffer(Gtk::PasswordEntry &entry);
+} // namespace Askpass
+
+#endif
\ No newline at end of file
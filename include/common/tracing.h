@@ -0,0 +1,14 @@
+#ifndef TRACING_H
+#define TRACING_H
+
+// Static tracepoints for measuring request latency, enabled with -Dusdt=enabled. The first argument
+// of every probe is the request id. When disabled the arguments are not evaluated.
+#ifdef ASKPASS_USDT
+# include <sys/sdt.h>
+
+# define ASKPASS_TRACE(name, ...) STAP_PROBEV(wayland_askpass, name, __VA_ARGS__)
+#else
+# define ASKPASS_TRACE(name, ...) ((void)0)
+#endif
+
+#endif
\ No newline at end of file
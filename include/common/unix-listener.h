@@ -0,0 +1,43 @@
+#ifndef UNIX_LISTENER_H
+#define UNIX_LISTENER_H
+
+#include <filesystem>
+
+#include <glibmm.h>
+#include <sigc++/signal.h>
+
+#include <sys/un.h>
+
+#include "unique_fd.h"
+
+namespace Askpass {
+    // Throws std::system_error with ENAMETOOLONG if path doesn't fit
+    sockaddr_un make_unix_address(const std::filesystem::path &path);
+
+    // Replaces a stale socket at path with a non-blocking listening socket of type. Throws
+    // std::system_error if it can't listen there.
+    wrapper::unique_fd listen_unix_socket(const std::filesystem::path &path, int type);
+
+    // Accepts the connections of a listening socket from the main loop. A listener stays readable
+    // while accepting fails, e.g. without free fds, so after such an error it is only watched again
+    // after a pause instead of spinning the main loop.
+    class UnixListener {
+        wrapper::unique_fd m_fd;
+        int m_accept_flags;
+        sigc::slot<void(wrapper::unique_fd &)> m_on_accepted;
+        sigc::scoped_connection m_watch {};
+        sigc::scoped_connection m_retry_timeout {};
+
+        void watch();
+        bool on_io(Glib::IOCondition);
+
+    public:
+        // on_accepted takes over every connection. They are close-on-exec, accept_flags may add
+        // SOCK_NONBLOCK. sigc++ can't pass move-only arguments by value, hence the reference.
+        UnixListener(wrapper::unique_fd fd, int accept_flags, const sigc::slot<void(wrapper::unique_fd &)> &on_accepted);
+
+        UnixListener(const UnixListener &) = delete;
+    };
+} // namespace Askpass
+
+#endif
\ No newline at end of file
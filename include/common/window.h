@@ -5,6 +5,7 @@
 
 #include "concepts.h"
 #include "exit_codes.h"
+#include "profiling.h"
 
 namespace Askpass {
     class Window final : public Gtk::ApplicationWindow {
@@ -22,6 +23,8 @@ namespace Askpass {
 
         bool m_finished = false;
 
+        sigc::scoped_connection m_first_frame_watch;
+
     public:
         Window(const Glib::ustring &label_text);
 
@@ -33,6 +36,14 @@ namespace Askpass {
 
         ~Window();
 
+        // Re-binds a hidden window to the next model, keeping its widgets and surface.
+        void bind(WindowModelInterface<Window> auto &model) {
+            reset(model.message());
+            model.register_window(*this);
+        }
+
+        void set_message(std::string_view label_text);
+
         sigc::signal<on_succeeded_func_t> signal_succeeded() { return m_signal_succeeded; }
 
         sigc::signal<on_failure_func_t> signal_failure() { return m_signal_failure; }
@@ -47,14 +58,23 @@ namespace Askpass {
         void emit_failure();
 
         void setup_controllers();
+        void on_first_frame();
+        void reset(std::string_view label_text);
     };
 
     static_assert(WindowInterface<Window>);
 
+    // Marks application_created, display_opened and startup for application
+    void mark_application_phases(const Glib::RefPtr<Gtk::Application> &application);
+
+    // Flags for Gtk::Application::create. WAYLAND_ASKPASS_NON_UNIQUE=1 skips the D-Bus registration.
+    Gio::Application::Flags application_flags();
+
     void make_and_run_window(std::string_view app_id, WindowModelInterface<Window> auto &model) {
         static constexpr const char AllowedBackends[] = "wayland,x11";
         gdk_set_allowed_backends(AllowedBackends);
-        auto app = Gtk::Application::create(std::string(app_id));
+        auto app = Gtk::Application::create(std::string(app_id), application_flags());
+        mark_application_phases(app);
         if (app->make_window_and_run<Askpass::Window>(0, nullptr, model)) {
             return exit(ExitCode::Unknown);
         }
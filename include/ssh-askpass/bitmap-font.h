@@ -0,0 +1,18 @@
+#ifndef BITMAP_FONT_H
+#define BITMAP_FONT_H
+
+#include <array>
+#include <cstdint>
+
+namespace Askpass {
+    inline constexpr int GlyphWidth  = 5;
+    inline constexpr int GlyphHeight = 7;
+
+    // One byte per row, top to bottom. Bit 4 is the leftmost column.
+    using Glyph = std::array<std::uint8_t, GlyphHeight>;
+
+    // Printable ASCII is covered, everything else is drawn as '?'
+    const Glyph &get_glyph(char32_t code_point) noexcept;
+} // namespace Askpass
+
+#endif
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef BROKER_H
+#define BROKER_H
+
+#include <optional>
+#include <string_view>
+
+#include "exit_codes.h"
+
+namespace Askpass {
+    // Resident mode is enabled by setting WAYLAND_SSH_ASKPASS_RESIDENT=1. The first invocation forks a
+    // broker which keeps GTK initialized and serves the prompts of all later invocations over a unix
+    // socket in $XDG_RUNTIME_DIR. The broker exits after WAYLAND_SSH_ASKPASS_RESIDENT_IDLE_TIMEOUT
+    // seconds without prompts.
+    //
+    // Returns the exit code of the forwarded prompt after its answer has been written to stdout, or
+    // std::nullopt if resident mode is disabled or the broker is unavailable.
+    std::optional<ExitCode> forward_to_resident_broker(std::string_view app_id, int argc, char **argv);
+} // namespace Askpass
+
+#endif
\ No newline at end of file
@@ -6,29 +6,42 @@
 
 #include <sigc++/signal.h>
 
+#include <unistd.h>
+
 #include "concepts.h"
 #include "exit_codes.h"
+#include "output-sink.h"
 
 namespace Askpass {
     class Model : public sigc::trackable {
         std::string m_message;
+        int m_output_fd;
         ExitCode m_exit_status {0};
+        OutputSink m_output {};
 
-        static void on_succeeded(std::string_view input);
+        void on_succeeded(std::string_view input);
         void on_failure();
+        void on_output_done(int error);
 
     public:
-        Model(std::string message);
+        Model(std::string message, int output_fd = STDOUT_FILENO);
 
         void register_window(WindowInterface auto &window) {
-            window.signal_succeeded().connect(sigc::ptr_fun(on_succeeded));
+            window.signal_succeeded().connect(sigc::mem_fun(*this, &Model::on_succeeded));
             window.signal_failure().connect(sigc::mem_fun(*this, &Model::on_failure));
         }
 
         constexpr std::string_view message() const noexcept { return m_message; }
 
+        // Whether the answer is still being written. The exit status is final once this is false.
+        bool is_writing() const noexcept { return m_output.is_writing(); }
+
+        sigc::signal<void(int)> signal_written() noexcept { return m_output.signal_done(); }
+
         constexpr ExitCode exit_status() const noexcept { return m_exit_status; }
     };
+
+    std::string build_message(int argc, char **argv);
 } // namespace Askpass
 
 #endif
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef NATIVE_WINDOW_H
+#define NATIVE_WINDOW_H
+
+#include <memory>
+#include <string_view>
+
+#include <sigc++/signal.h>
+
+#include "concepts.h"
+
+namespace Askpass {
+    struct NativeConnection;
+
+    // A prompt without GTK. It talks to the compositor directly, shows a wlr layer-shell surface
+    // drawn into a wl_shm buffer with a builtin bitmap font and reads keys through xkbcommon.
+    // Input methods and accessibility are only available with the GTK window.
+    class NativeWindow {
+        std::unique_ptr<NativeConnection> m_connection;
+
+        explicit NativeWindow(std::unique_ptr<NativeConnection> connection);
+
+    public:
+        // Returns nullptr if the compositor can't show the prompt, or WAYLAND_ASKPASS_NATIVE=0 is set
+        static std::unique_ptr<NativeWindow> connect(std::string_view message);
+
+        ~NativeWindow();
+
+        sigc::signal<on_succeeded_func_t> signal_succeeded();
+
+        sigc::signal<on_failure_func_t> signal_failure();
+
+        // Dispatches Wayland events until the prompt is answered or cancelled
+        void run();
+    };
+
+    static_assert(WindowInterface<NativeWindow>);
+
+    // Returns false if the prompt has to be shown by GTK instead
+    bool run_native_window(WindowModelInterface<NativeWindow> auto &model) {
+        auto window = NativeWindow::connect(model.message());
+        if (!window) {
+            return false;
+        }
+        model.register_window(*window);
+        window->run();
+        return true;
+    }
+} // namespace Askpass
+
+#endif
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef ASK_FILE_PARSER_H
+#define ASK_FILE_PARSER_H
+
+#include <cstddef>
+#include <ctime>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace Askpass {
+    // The [Ask] section of a systemd ask-password file. The views point into the parsed buffer.
+    struct AskFile {
+        std::string_view message {"No message"};
+        std::string_view id {};
+        std::string_view icon {};
+        std::string_view socket {};
+        int pid {};
+        time_t not_after {};
+        bool echo {};
+        bool accept_cached {};
+    };
+
+    class AskFileParseError : public std::runtime_error {
+        std::size_t m_line;
+
+    public:
+        AskFileParseError(std::size_t line, const std::string &message);
+
+        constexpr std::size_t line() const noexcept { return m_line; }
+    };
+
+    // Parses the ask-password file format written by systemd without copying the buffer.
+    // Unknown keys and sections are ignored. Throws AskFileParseError on malformed input.
+    AskFile parse_ask_file(std::string_view buffer);
+
+    // Parses a request sent over the request socket. It has the same format, but PID= and Socket=
+    // are optional, as the connection identifies both.
+    AskFile parse_ask_request(std::string_view buffer);
+} // namespace Askpass
+
+#endif
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef CONSOLE_UI_H
+#define CONSOLE_UI_H
+
+#include <ctime>
+#include <optional>
+#include <string_view>
+
+#include <glibmm.h>
+#include <sigc++/connection.h>
+#include <sigc++/signal.h>
+
+#include <termios.h>
+
+#include "concepts.h"
+#include "deadline-timer.h"
+#include "model.h"
+#include "secure-buffer.h"
+#include "unique_fd.h"
+#include "window-model.h"
+
+namespace Askpass {
+    // The prompt of a ConsoleUi
+    class ConsoleWindow {
+        sigc::signal<on_succeeded_func_t> m_signal_succeeded {};
+        sigc::signal<on_failure_func_t> m_signal_failure {};
+
+    public:
+        sigc::signal<on_succeeded_func_t> signal_succeeded() { return m_signal_succeeded; }
+
+        sigc::signal<on_failure_func_t> signal_failure() { return m_signal_failure; }
+    };
+
+    static_assert(WindowInterface<ConsoleWindow>);
+
+    // A UiInterface prompting on the controlling terminal, for sessions without a display. Input is
+    // read without echo from the main loop, so no GTK is initialized. Enter answers, Escape or
+    // Ctrl-C cancels.
+    class ConsoleUi : public sigc::trackable {
+        Glib::RefPtr<Glib::MainLoop> m_main_loop;
+        wrapper::unique_fd m_tty_fd;
+        std::optional<termios> m_saved_attributes {};
+        std::optional<ConsoleWindow> m_window {};
+        // Set from close_window() until the window is reported closed, so it is reported only once
+        bool m_closing {false};
+        SecureBuffer m_input {};
+        DeadlineTimer m_deadline_timer {};
+        sigc::scoped_connection m_input_watch {};
+        sigc::signal<void(void)> m_window_closed_signal {};
+
+        void print(std::string_view text);
+        void print_prompt(std::string_view message);
+        bool on_input(Glib::IOCondition);
+        void on_key(char key);
+        void emit_signal_window_closed();
+
+    public:
+        ConsoleUi();
+
+        ~ConsoleUi();
+
+        ConsoleUi(const ConsoleUi &) = delete;
+
+        // Whether a controlling terminal could be opened
+        bool has_terminal() const noexcept { return m_tty_fd.get() >= 0; }
+
+        sigc::signal<void(void)> signal_window_closed() noexcept { return m_window_closed_signal; }
+
+        void spawn_window(WindowModel &model);
+
+        void update_window(WindowModel &model);
+
+        void close_window();
+
+        time_t now() const { return g_get_monotonic_time(); }
+
+        sigc::connection set_deadline(time_t deadline, const sigc::slot<void()> &func) {
+            return m_deadline_timer.arm(deadline, func);
+        }
+
+        sigc::connection watch_process(int pid, const sigc::slot<void()> &func);
+
+        int run(int argc, char *argv[]);
+
+        void stop() { m_main_loop->quit(); }
+
+        void quit() { m_main_loop->quit(); }
+    };
+
+    static_assert(UiInterface<ConsoleUi>);
+} // namespace Askpass
+
+#endif
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef DEADLINE_TIMER_H
+#define DEADLINE_TIMER_H
+
+#include <ctime>
+
+#include <glibmm.h>
+#include <sigc++/connection.h>
+#include <sigc++/functors/slot.h>
+
+#include "unique_fd.h"
+
+namespace Askpass {
+    // A CLOCK_MONOTONIC timerfd on the main loop, armed for an absolute deadline in microseconds.
+    // Arming it again replaces the previous deadline and callback, so no timer source is created
+    // per request and the deadline is not rounded to milliseconds.
+    class DeadlineTimer {
+        wrapper::unique_fd m_timer_fd;
+        sigc::scoped_connection m_io_watch {};
+        sigc::slot<void()> m_func {};
+
+        bool on_expired(Glib::IOCondition);
+
+    public:
+        DeadlineTimer();
+
+        DeadlineTimer(const DeadlineTimer &) = delete;
+
+        // Calls func from the main loop once deadline has passed. The returned connection cancels it.
+        sigc::connection arm(time_t deadline, const sigc::slot<void()> &func);
+    };
+} // namespace Askpass
+
+#endif
\ No newline at end of file
@@ -0,0 +1,151 @@
+#ifndef HEADLESS_UI_H
+#define HEADLESS_UI_H
+
+#include <atomic>
+#include <ctime>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <glibmm.h>
+#include <sigc++/connection.h>
+#include <sigc++/signal.h>
+
+#include "concepts.h"
+#include "model.h"
+#include "window-model.h"
+
+namespace Askpass {
+    // Stands in for the window of a HeadlessUi
+    class HeadlessWindow {
+        sigc::signal<on_succeeded_func_t> m_signal_succeeded {};
+        sigc::signal<on_failure_func_t> m_signal_failure {};
+
+    public:
+        sigc::signal<on_succeeded_func_t> signal_succeeded() { return m_signal_succeeded; }
+
+        sigc::signal<on_failure_func_t> signal_failure() { return m_signal_failure; }
+    };
+
+    static_assert(WindowInterface<HeadlessWindow>);
+
+    // A UiInterface without a display, for driving Askpass::Model from tools. The clock only moves in
+    // advance(), which also fires the deadline once it is due. dispatch() runs what the model's workers
+    // posted to the default main context and reports a closed window, like UiManager reports it from
+    // an idle callback.
+    class HeadlessUi {
+        struct window_state {
+            HeadlessWindow window {};
+            std::string message {};
+        };
+
+        std::atomic<time_t> m_now;
+        std::optional<std::pair<time_t, sigc::slot<void()>>> m_deadline {};
+        std::multimap<int, sigc::slot<void()>> m_process_watches {};
+        std::optional<window_state> m_window {};
+        bool m_close_pending {false};
+        sigc::signal<void(void)> m_window_closed_signal {};
+        std::size_t m_windows_spawned {0};
+
+    public:
+        explicit HeadlessUi(time_t start_time = 1) : m_now(start_time) {}
+
+        time_t now() const { return m_now.load(std::memory_order_relaxed); }
+
+        sigc::signal<void(void)> signal_window_closed() noexcept { return m_window_closed_signal; }
+
+        void spawn_window(WindowModel &model) {
+            m_window.emplace();
+            m_window->message = model.message();
+            model.register_window(m_window->window);
+            ++m_windows_spawned;
+        }
+
+        void update_window(WindowModel &model) { m_window->message = model.message(); }
+
+        void close_window() { m_close_pending = m_window.has_value(); }
+
+        sigc::connection set_deadline(time_t deadline, const sigc::slot<void()> &func) {
+            m_deadline.emplace(deadline, func);
+            return sigc::connection(m_deadline->second);
+        }
+
+        sigc::connection watch_process(int pid, const sigc::slot<void()> &func) {
+            auto it = m_process_watches.emplace(pid, func);
+            return sigc::connection(it->second);
+        }
+
+        bool has_window() const noexcept { return m_window.has_value() && !m_close_pending; }
+
+        std::string_view window_message() const noexcept {
+            return m_window ? std::string_view(m_window->message) : std::string_view {};
+        }
+
+        std::size_t windows_spawned() const noexcept { return m_windows_spawned; }
+
+        // Acts like the user answering or cancelling the open window
+        void answer(std::string_view input) {
+            m_window->window.signal_succeeded().emit(input);
+            close_window();
+        }
+
+        void cancel() {
+            m_window->window.signal_failure().emit();
+            close_window();
+        }
+
+        void exit_process(int pid) {
+            // Extracted nodes keep their address, so disconnecting a later watch from an earlier one works
+            std::vector<decltype(m_process_watches)::node_type> watches;
+            while (m_process_watches.contains(pid)) {
+                watches.push_back(m_process_watches.extract(pid));
+            }
+            for (auto &watch : watches) {
+                if (!watch.mapped().empty()) {
+                    watch.mapped()();
+                }
+            }
+            dispatch();
+        }
+
+        void advance(time_t microseconds) {
+            m_now += microseconds;
+            // The callback may arm the next deadline, which can already be due as well
+            while (m_deadline && m_deadline->first <= now()) {
+                auto func = std::move(m_deadline->second);
+                m_deadline.reset();
+                if (!func.empty()) {
+                    func();
+                }
+            }
+            dispatch();
+        }
+
+        void dispatch() {
+            auto context = Glib::MainContext::get_default();
+            while (context->iteration(false)) {}
+            while (m_close_pending) {
+                m_close_pending = false;
+                m_window.reset();
+                m_window_closed_signal.emit();
+            }
+        }
+
+        // Blocks on the default main context until pred holds, e.g. until every file was read
+        template<class Pred>
+        void dispatch_until(Pred &&pred) {
+            dispatch();
+            while (!pred()) {
+                Glib::MainContext::get_default()->iteration(true);
+                dispatch();
+            }
+        }
+    };
+
+    static_assert(UiInterface<HeadlessUi>);
+} // namespace Askpass
+
+#endif
\ No newline at end of file
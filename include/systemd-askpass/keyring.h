@@ -0,0 +1,20 @@
+#ifndef KEYRING_H
+#define KEYRING_H
+
+#include <string_view>
+
+#include "secure-buffer.h"
+
+namespace Askpass {
+    // Seconds an entered answer stays in the user keyring, like systemd's own agents
+    inline constexpr unsigned int DefaultCacheTimeout = 150;
+
+    // Reads the answer cached under id from the user keyring. Returns false if there is none or it
+    // doesn't fit into answer.
+    bool lookup_cached_answer(std::string_view id, SecureBuffer &answer);
+
+    // Caches answer under id in the user keyring, where it expires after timeout seconds
+    void store_cached_answer(std::string_view id, std::string_view answer, unsigned int timeout);
+} // namespace Askpass
+
+#endif
\ No newline at end of file
@@ -0,0 +1,28 @@
+#ifndef METRICS_ENDPOINT_H
+#define METRICS_ENDPOINT_H
+
+#include <filesystem>
+
+#include "unique_fd.h"
+#include "unix-listener.h"
+
+namespace Askpass {
+    // Serves metrics() on a unix socket. Every connection receives the current values in the
+    // Prometheus text format and is closed, so e.g. `socat - UNIX-CONNECT:<path>` scrapes it.
+    class MetricsEndpoint {
+        std::filesystem::path m_path;
+        UnixListener m_listener;
+
+        void on_accepted(wrapper::unique_fd &connection);
+
+    public:
+        // Replaces a stale socket at path. Throws std::system_error if it can't listen there.
+        explicit MetricsEndpoint(std::filesystem::path path);
+
+        MetricsEndpoint(const MetricsEndpoint &) = delete;
+
+        ~MetricsEndpoint();
+    };
+} // namespace Askpass
+
+#endif
\ No newline at end of file
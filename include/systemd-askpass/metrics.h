@@ -0,0 +1,60 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <string_view>
+
+namespace Askpass {
+    // What happened to a request. Every ask file is seen once and then parsed or rejected. Parsed
+    // requests end up answered, cancelled, expired or orphaned, unless their file is deleted first.
+    enum class RequestEvent { Seen, Parsed, Rejected, Expired, Orphaned, Answered, Cancelled, Max };
+
+    // Upper bounds of the latency buckets in microseconds, from the main loop's reaction time up to
+    // a user walking away from the prompt
+    inline constexpr std::array<time_t, 15> LatencyBuckets {1000, 5000, 10000, 50000, 100000, 250000,
+        500000, 1000000, 2500000, 5000000, 10000000, 30000000, 60000000, 120000000, 300000000};
+
+    // Counts observations per bucket with relaxed atomics, so observe() never takes a lock
+    class LatencyHistogram {
+        // The last bucket takes everything above the largest bound
+        std::array<std::atomic<std::uint64_t>, LatencyBuckets.size() + 1> m_buckets {};
+        std::atomic<std::uint64_t> m_sum {0};
+
+    public:
+        void observe(time_t microseconds) noexcept;
+
+        // Appends the cumulative buckets, sum and count in seconds
+        void format(std::string &output, std::string_view name) const;
+    };
+
+    // The process wide registry, updated from the main loop and the prefetch threads
+    struct Metrics {
+        std::array<std::atomic<std::uint64_t>, static_cast<std::size_t>(RequestEvent::Max)> requests {};
+
+        // Requests waiting for a window, being read and shown, and closed windows whose answers are
+        // still being written
+        std::atomic<std::uint64_t> queued {0};
+        std::atomic<std::uint64_t> prefetching {0};
+        std::atomic<std::uint64_t> shown {0};
+        std::atomic<std::uint64_t> writing {0};
+
+        // From the ask file's event to the window showing the request
+        LatencyHistogram event_to_window {};
+        // From showing a window to the user's answer or cancellation
+        LatencyHistogram window_to_answer {};
+
+        void count(RequestEvent event, std::uint64_t requests = 1) noexcept;
+
+        // Renders everything in the Prometheus text exposition format
+        std::string format() const;
+    };
+
+    Metrics &metrics() noexcept;
+} // namespace Askpass
+
+#endif
\ No newline at end of file
@@ -1,22 +1,42 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+#include <algorithm>
 #include <cassert>
 #include <csignal>
+#include <cstdint>
+#include <ctime>
 #include <iostream>
+#include <memory>
 #include <optional>
-#include <unordered_set>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <giomm.h>
 #include <gtkmm.h>
 
+#include "keyring.h"
+#include "metrics.h"
+#include "request-queue.h"
+#include "secure-buffer.h"
+#include "tracing.h"
+#include "unique_fd.h"
 #include "window-model.h"
+#include "worker-pool.h"
 
 namespace Askpass::detail {
     struct AskpassFileImpl {
-        Glib::RefPtr<Gio::File> file;
+        std::shared_ptr<const wrapper::unique_fd> directory;
+        std::string name;
+        // Identifies the request in traces, not part of the file's identity
+        std::uint64_t request_id;
+        // When the file's event arrived, in microseconds of CLOCK_MONOTONIC. Not part of the
+        // identity either.
+        time_t event_time {0};
 
-        AskpassFileImpl(Glib::RefPtr<Gio::File> file);
+        AskpassFileImpl(std::shared_ptr<const wrapper::unique_fd> directory, std::string name,
+            std::uint64_t request_id = 0);
     };
 
     bool operator==(const AskpassFileImpl &lhs, const AskpassFileImpl &rhs) noexcept;
@@ -26,7 +46,7 @@ namespace Askpass::detail {
 
 template<>
 struct std::hash<Askpass::detail::AskpassFileImpl> {
-    guint operator()(const Askpass::detail::AskpassFileImpl &file) const noexcept;
+    std::size_t operator()(const Askpass::detail::AskpassFileImpl &file) const noexcept;
 };
 
 namespace Askpass {
@@ -35,130 +55,455 @@ namespace Askpass {
         { read_askpass_file(obj) } -> std::same_as<std::unique_ptr<SystemdAskpassContext>>;
     };
 
+    // now() returns the current CLOCK_MONOTONIC time in microseconds and must be callable from any thread.
+    // set_deadline() arms a single timer for an absolute time on that clock, replacing the previous one.
     template<class T>
-    concept UiInterface = requires(T &obj, WindowModel &window_model, unsigned int milliseconds,
-        const sigc::slot<bool()> &timeout_func) {
+    concept UiInterface = requires(T &obj, WindowModel &window_model, time_t deadline,
+        const sigc::slot<void()> &deadline_func, int pid, const sigc::slot<void()> &process_exited_func) {
+        { obj.now() } -> std::same_as<time_t>;
         obj.spawn_window(window_model);
+        obj.update_window(window_model);
         obj.close_window();
-        { obj.set_timeout(milliseconds, timeout_func) } -> std::same_as<sigc::connection>;
+        { obj.set_deadline(deadline, deadline_func) } -> std::same_as<sigc::connection>;
+        { obj.watch_process(pid, process_exited_func) } -> std::same_as<sigc::connection>;
         { obj.signal_window_closed() } -> std::same_as<sigc::signal<void(void)>>;
     };
 
-    template<class T>
-    class FileStorage {
-        std::unordered_set<T> m_storage;
-
-    public:
-        void add_file(const T &file) { m_storage.emplace(file); }
-
-        void add_file(T &&file) { m_storage.emplace(std::move(file)); }
+    using AskpassFile = detail::AskpassFileImpl;
+    static_assert(AskpassFileInterface<AskpassFile>);
 
-        void remove_file(const T &file) { m_storage.erase(file); }
+    // Ask files are read, parsed and connected ahead of time on this many threads
+    inline constexpr unsigned int PrefetchThreads = 2;
 
-        T dequeue_file() {
-            if (empty()) {
-                throw std::runtime_error("dequeue while storage is empty");
-            }
-            auto begin = m_storage.begin();
-            auto node  = m_storage.extract(begin);
-            return std::move(node.value());
-        }
-
-        bool empty() const noexcept { return m_storage.empty(); }
+    struct ModelConfig {
+        QueuePolicy queue_policy {QueuePolicy::EarliestDeadline};
+        // Answer all requests with the same Id, or the same Message if they have no Id, from one prompt
+        bool batch_requests {false};
+        // Seconds entered answers stay in the user keyring for requests with AcceptCached=1, zero
+        // disables the cache
+        unsigned int cache_timeout {DefaultCacheTimeout};
     };
 
-    using AskpassFile = detail::AskpassFileImpl;
-    static_assert(AskpassFileInterface<AskpassFile>);
-
     template<UiInterface T>
     class Model : public sigc::trackable {
+        // Evict a request as soon as the asking process exits or, for the request socket, the
+        // client hangs up, whether it is queued or shown
+        struct request_watches {
+            sigc::scoped_connection process {};
+            sigc::scoped_connection hangup {};
+        };
+
+        struct queued_request {
+            std::unique_ptr<SystemdAskpassContext> context;
+            request_watches watches {};
+        };
+
+        struct prefetch_result {
+            std::unique_ptr<SystemdAskpassContext> context {};
+            std::string error {};
+        };
+
+        // The requests answered by the open window. files and watches are parallel to the contexts
+        // of window_model.
         struct run_context {
             WindowModel window_model;
-            AskpassFile current_file;
-            sigc::scoped_connection timeout_slot {};
+            std::vector<AskpassFile> files {};
+            std::vector<request_watches> watches {};
+            time_t shown_at {0};
+
+            run_context(AskpassFile file, queued_request request, unsigned int cache_timeout) :
+                    window_model(std::move(request.context), cache_timeout) {
+                files.push_back(std::move(file));
+                watches.push_back(std::move(request.watches));
+            }
+
+            void add(AskpassFile file, queued_request request) {
+                window_model.add_context(std::move(request.context));
+                files.push_back(std::move(file));
+                watches.push_back(std::move(request.watches));
+            }
 
-            run_context(std::unique_ptr<SystemdAskpassContext> askpass_context, AskpassFile file) :
-                    window_model(std::move(askpass_context)), current_file(std::move(file)) {}
+            void remove(std::size_t index) {
+                window_model.remove_context(index);
+                files.erase(files.begin() + index);
+                watches.erase(watches.begin() + index);
+            }
+
+            std::optional<std::size_t> find(const AskpassFile &file) const {
+                if (auto it = std::find(files.begin(), files.end(), file); it != files.end()) {
+                    return it - files.begin();
+                }
+                return {};
+            }
         };
 
         T &m_ui_manager;
-        FileStorage<AskpassFile> m_current_askpass_files;
+        ModelConfig m_config;
+        RequestQueue<AskpassFile, queued_request> m_current_askpass_files;
         std::unique_ptr<run_context> m_run_context;
+        // Closed windows whose answers are still being written
+        std::vector<std::unique_ptr<run_context>> m_writing_run_contexts {};
+        SecureBuffer m_cached_answer {};
+        // One timer for the earliest deadline of the open window and the queue
+        sigc::scoped_connection m_deadline_slot {};
+        time_t m_armed_deadline {0};
+        // Files being read on the worker pool, with the generation of their latest prefetch
+        std::unordered_map<AskpassFile, std::uint64_t> m_prefetching {};
+        std::uint64_t m_prefetch_generation {0};
+        // Declared last, so the workers are joined before anything they hand results to is destroyed
+        WorkerPool m_workers {PrefetchThreads};
+
+        time_t current_time() const { return m_ui_manager.now(); }
+
+        // NotAfter is in microseconds of CLOCK_MONOTONIC, zero means no timeout
+        bool is_expired(time_t not_after) const { return not_after != 0 && not_after <= current_time(); }
+
+        static bool is_orphaned(const SystemdAskpassContext &context) {
+            return kill(context.pid(), 0) < 0 && errno == ESRCH;
+        }
+
+        static bool is_same_batch(const SystemdAskpassContext &lhs, const SystemdAskpassContext &rhs) {
+            if (!lhs.id().empty() || !rhs.id().empty()) {
+                return lhs.id() == rhs.id();
+            }
+            return lhs.message() == rhs.message();
+        }
+
+        // An answered window has written its answers already, so a request joining it before it is
+        // closed would never be answered
+        bool joins_open_window(const SystemdAskpassContext &context) const {
+            return m_config.batch_requests && m_run_context && !m_run_context->files.empty()
+                   && !m_run_context->window_model.is_answered()
+                   && is_same_batch(m_run_context->window_model.context(0), context);
+        }
+
+        // Keeps the timer armed for the earliest deadline of all requests, so expired requests are
+        // evicted while they wait instead of when they are dequeued
+        void update_deadline() {
+            update_gauges();
+            time_t deadline = m_current_askpass_files.next_deadline();
+            if (time_t window_deadline = m_run_context ? m_run_context->window_model.timeout() : 0;
+                window_deadline != 0 && (deadline == 0 || window_deadline < deadline)) {
+                deadline = window_deadline;
+            }
+            if (deadline == m_armed_deadline) {
+                return;
+            }
+            m_armed_deadline = deadline;
+            m_deadline_slot.disconnect();
+            if (deadline != 0) {
+                m_deadline_slot = m_ui_manager.set_deadline(deadline, sigc::mem_fun(*this, &Model::on_deadline));
+            }
+        }
 
-        static unsigned int calculate_timeout(time_t microseconds) {
-            if (microseconds == 0) {
-                return 0;
+        // Evicts every expired request in one pass
+        void on_deadline() {
+            m_armed_deadline = 0;
+            m_current_askpass_files.expire(
+                current_time(), []([[maybe_unused]] const AskpassFile &file, const queued_request &) {
+                    std::cout << "Askpass request timed out while queued\n";
+                    metrics().count(RequestEvent::Expired);
+                    ASKPASS_TRACE(request_dropped, file.request_id);
+                });
+            if (m_run_context) {
+                for (std::size_t i = m_run_context->files.size(); i-- > 0;) {
+                    if (is_expired(m_run_context->window_model.context(i).timeout())) {
+                        metrics().count(RequestEvent::Expired);
+                        ASKPASS_TRACE(request_dropped, m_run_context->window_model.context(i).request_id());
+                        m_run_context->remove(i);
+                    }
+                }
+                if (m_run_context->files.empty()) {
+                    m_ui_manager.close_window();
+                } else {
+                    m_ui_manager.update_window(m_run_context->window_model);
+                }
             }
-            timespec buffer {};
-            if (clock_gettime(CLOCK_MONOTONIC, &buffer) < 0) {
-                std::abort();
+            update_deadline();
+        }
+
+        // Drops one request from the open window, closing it once no request is left
+        void remove_from_open_window(std::size_t index) {
+            m_run_context->remove(index);
+            if (m_run_context->files.empty()) {
+                m_ui_manager.close_window();
+            } else {
+                m_ui_manager.update_window(m_run_context->window_model);
             }
-            time_t current_milli_sec = buffer.tv_sec * 1000 + buffer.tv_nsec / 1000000;
-            return std::max<unsigned int>(0, (microseconds / 1000) - current_milli_sec);
+            update_deadline();
+        }
+
+        bool is_dispatchable(const queued_request &request) const {
+            if (is_expired(request.context->timeout())) {
+                std::cout << "Askpass request already timed out\n";
+                metrics().count(RequestEvent::Expired);
+                ASKPASS_TRACE(request_dropped, request.context->request_id());
+                return false;
+            }
+            if (is_orphaned(*request.context)) {
+                std::cout << "Askpass process already disappeared\n";
+                metrics().count(RequestEvent::Orphaned);
+                ASKPASS_TRACE(request_dropped, request.context->request_id());
+                return false;
+            }
+            return true;
+        }
+
+        // Keeps a finished run context until its answers are written
+        void retire(std::unique_ptr<run_context> finished) {
+            if (!finished->window_model.is_writing()) {
+                return;
+            }
+            run_context *pending = finished.get();
+            pending->watches.clear();
+            pending->window_model.signal_written().connect([this, pending]() {
+                std::erase_if(m_writing_run_contexts, [pending](const std::unique_ptr<run_context> &ptr) {
+                    return ptr.get() == pending;
+                });
+                update_gauges();
+            });
+            m_writing_run_contexts.push_back(std::move(finished));
+        }
+
+        // Answers the requests of window_context from the keyring if the first one allows it
+        bool answer_from_cache(std::unique_ptr<run_context> &window_context) {
+            const SystemdAskpassContext &context = window_context->window_model.context(0);
+            if (m_config.cache_timeout == 0 || !context.accept_cached() || context.id().empty()
+                || !lookup_cached_answer(context.id(), m_cached_answer)) {
+                return false;
+            }
+            window_context->window_model.answer_from_cache(m_cached_answer.view());
+            m_cached_answer.clear();
+            retire(std::move(window_context));
+            return true;
         }
 
         std::unique_ptr<run_context> make_next_window_model() {
             while (!m_current_askpass_files.empty()) {
-                AskpassFile file = m_current_askpass_files.dequeue_file();
-                std::unique_ptr<SystemdAskpassContext> context;
-                try {
-                    context = read_askpass_file(file);
-                } catch (const std::runtime_error &ex) {
-                    std::cerr << "Reading Askpass file failed:\n" << ex.what() << '\n';
+                auto [file, request] = m_current_askpass_files.pop();
+                if (!is_dispatchable(request)) {
                     continue;
                 }
-                if (calculate_timeout(context->timeout()) <= 0) {
-                    std::cout << "Askpass request already timed out\n";
-                    continue;
+                auto window_context
+                    = std::make_unique<run_context>(std::move(file), std::move(request), m_config.cache_timeout);
+                if (m_config.batch_requests) {
+                    const SystemdAskpassContext &first = window_context->window_model.context(0);
+                    auto batch = m_current_askpass_files.extract_if(
+                        [&](const AskpassFile &, const queued_request &other) {
+                            return is_same_batch(first, *other.context);
+                        });
+                    for (auto &[other_file, other_request] : batch) {
+                        if (is_dispatchable(other_request)) {
+                            window_context->add(std::move(other_file), std::move(other_request));
+                        }
+                    }
                 }
-                if (kill(context->pid(), 0) < 0 && errno == ESRCH) {
-                    std::cout << "Askpass process already disappeared\n";
+                if (answer_from_cache(window_context)) {
                     continue;
                 }
-                return std::make_unique<run_context>(std::move(context), std::move(file));
+                return window_context;
             }
             return {};
         }
 
+        void observe_shown(const AskpassFile &file) {
+            metrics().event_to_window.observe(current_time() - file.event_time);
+        }
+
+        // Called after every change of the queue, the prefetches or the windows
+        void update_gauges() {
+            Metrics &registry = metrics();
+            registry.queued.store(m_current_askpass_files.size(), std::memory_order_relaxed);
+            registry.prefetching.store(m_prefetching.size(), std::memory_order_relaxed);
+            registry.shown.store(m_run_context ? m_run_context->files.size() : 0, std::memory_order_relaxed);
+            registry.writing.store(m_writing_run_contexts.size(), std::memory_order_relaxed);
+        }
+
         void check_spawn_window() {
             if (std::unique_ptr<run_context> window_context;
                 !m_run_context && (window_context = make_next_window_model())) {
                 m_ui_manager.spawn_window(window_context->window_model);
-                window_context->timeout_slot
-                    = m_ui_manager.set_timeout(calculate_timeout(window_context->window_model.timeout()),
-                        sigc::mem_fun(*this, &Model::on_timeout));
+                window_context->shown_at = current_time();
+                for (const AskpassFile &file : window_context->files) {
+                    observe_shown(file);
+                }
                 m_run_context = std::move(window_context);
             }
+            update_deadline();
+        }
+
+        // The requests of an answered window are done, whatever happens to them until it is closed
+        bool is_answered(const AskpassFile &file) const {
+            return m_run_context && m_run_context->window_model.is_answered() && m_run_context->find(file);
+        }
+
+        void remove_request(const AskpassFile &file) {
+            if (is_answered(file)) {
+                return;
+            }
+            ASKPASS_TRACE(request_dropped, file.request_id);
+            if (auto index = m_run_context ? m_run_context->find(file) : std::nullopt) {
+                remove_from_open_window(*index);
+            } else if (!m_prefetching.erase(file)) {
+                m_current_askpass_files.remove(file);
+                update_deadline();
+            } else {
+                update_gauges();
+            }
+        }
+
+        void on_process_exited(const AskpassFile &file) {
+            if (is_answered(file)) {
+                return;
+            }
+            std::cout << "Askpass process disappeared\n";
+            metrics().count(RequestEvent::Orphaned);
+            remove_request(file);
+        }
+
+        void on_client_hung_up(const AskpassFile &file) {
+            // Clients close the connection once they read their answer
+            if (is_answered(file)) {
+                return;
+            }
+            std::cout << "Askpass client hung up\n";
+            metrics().count(RequestEvent::Orphaned);
+            remove_request(file);
+        }
+
+        // Runs on a worker thread
+        prefetch_result prefetch(const AskpassFile &file) const {
+            prefetch_result result {};
+            try {
+                result.context = read_askpass_file(file);
+            } catch (const std::runtime_error &ex) {
+                result.error = std::string("Reading Askpass file failed:\n") + ex.what();
+                metrics().count(RequestEvent::Rejected);
+                return result;
+            }
+            metrics().count(RequestEvent::Parsed);
+            if (is_expired(result.context->timeout())) {
+                result.error = "Askpass request already timed out";
+                metrics().count(RequestEvent::Expired);
+            } else if (is_orphaned(*result.context)) {
+                result.error = "Askpass process already disappeared";
+                metrics().count(RequestEvent::Orphaned);
+            }
+            if (!result.error.empty()) {
+                result.context.reset();
+            }
+            return result;
+        }
+
+        void on_prefetched(const AskpassFile &file, std::uint64_t generation, prefetch_result result) {
+            // The file was deleted or recreated while we read it
+            if (auto it = m_prefetching.find(file); it == m_prefetching.end() || it->second != generation) {
+                return;
+            } else {
+                m_prefetching.erase(it);
+            }
+            if (!result.context) {
+                std::cerr << result.error << '\n';
+                ASKPASS_TRACE(request_dropped, file.request_id);
+                update_gauges();
+                return;
+            }
+            enqueue(file, queued_request {std::move(result.context)});
         }
 
-        bool on_timeout() {
-            m_ui_manager.close_window();
-            return false;
+        // Queues a parsed request or adds it to the open window of its batch
+        void enqueue(const AskpassFile &file, queued_request request) {
+            request.watches.process = m_ui_manager.watch_process(
+                request.context->pid(), [this, file]() { this->on_process_exited(file); });
+
+            if (joins_open_window(*request.context)) {
+                observe_shown(file);
+                m_run_context->add(file, std::move(request));
+                m_ui_manager.update_window(m_run_context->window_model);
+                update_deadline();
+                return;
+            }
+            time_t deadline = request.context->timeout();
+            m_current_askpass_files.push(file, std::move(request), deadline);
+            check_spawn_window();
         }
 
         void on_window_closed() {
+            if (m_run_context && m_run_context->window_model.is_answered()) {
+                metrics().window_to_answer.observe(current_time() - m_run_context->shown_at);
+            }
+            if (m_run_context) {
+                // Keep the answers alive until a slow reader took them
+                retire(std::move(m_run_context));
+            }
             m_run_context.reset();
             check_spawn_window();
         }
 
     public:
-        Model(T &ui_manager) : m_ui_manager(ui_manager) {
+        Model(T &ui_manager, ModelConfig config = {}) :
+                m_ui_manager(ui_manager), m_config(config), m_current_askpass_files(config.queue_policy) {
             m_ui_manager.signal_window_closed().connect([this]() { this->on_window_closed(); });
         }
 
         void on_file_created(AskpassFile file) {
-            m_current_askpass_files.add_file(std::move(file));
+            if ((m_run_context && m_run_context->find(file)) || m_current_askpass_files.contains(file)
+                || m_prefetching.contains(file)) {
+                return;
+            }
+
+            file.event_time          = current_time();
+            std::uint64_t generation = ++m_prefetch_generation;
+            m_prefetching.emplace(file, generation);
+            metrics().count(RequestEvent::Seen);
+            update_gauges();
+            ASKPASS_TRACE(request_queued, file.request_id);
+            m_workers.submit([this, file, generation]() {
+                ASKPASS_TRACE(prefetch_started, file.request_id);
+                auto result = std::make_shared<prefetch_result>(prefetch(file));
+                Glib::MainContext::get_default()->invoke([this, file, generation, result]() {
+                    this->on_prefetched(file, generation, std::move(*result));
+                    return false;
+                });
+            });
         }
 
-        void on_file_deleted(AskpassFile file) {
-            if (m_run_context && file == m_run_context->current_file) {
-                m_ui_manager.close_window();
+        void on_file_deleted(AskpassFile file) { remove_request(file); }
+
+        // A request which arrived parsed and connected on the request socket. It is known by a
+        // name no ask file can have, so it shares the queue and the windows with ask files.
+        void on_request_received(std::unique_ptr<SystemdAskpassContext> context) {
+            AskpassFile file {nullptr, "socket." + std::to_string(context->request_id()), context->request_id()};
+            file.event_time = current_time();
+            metrics().count(RequestEvent::Seen);
+            metrics().count(RequestEvent::Parsed);
+            ASKPASS_TRACE(request_queued, file.request_id);
+            if (queued_request request {std::move(context)}; !is_dispatchable(request)) {
+                // Dropping the request closes the connection without an answer
+                return;
             } else {
-                m_current_askpass_files.remove_file(file);
+                // The answer goes to the connection, so a client which closed it can't take one
+                request.watches.hangup = Glib::signal_io().connect(
+                    [this, file](Glib::IOCondition) {
+                        this->on_client_hung_up(file);
+                        return false;
+                    },
+                    request.context->answer_socket(),
+                    Glib::IOCondition::IO_HUP | Glib::IOCondition::IO_ERR);
+                enqueue(file, std::move(request));
             }
         }
 
         void on_file_events_ended() { check_spawn_window(); }
+
+        // Some ask file is still being read on the worker pool
+        bool is_prefetching() const noexcept { return !m_prefetching.empty(); }
+
+        // No request is being read, queued or shown
+        bool is_idle() const noexcept {
+            return !m_run_context && m_current_askpass_files.empty() && m_prefetching.empty()
+                   && m_writing_run_contexts.empty();
+        }
     };
 } // namespace Askpass
 
@@ -0,0 +1,13 @@
+#ifndef PROCESS_WATCH_H
+#define PROCESS_WATCH_H
+
+#include <sigc++/connection.h>
+#include <sigc++/functors/slot.h>
+
+namespace Askpass {
+    // Calls func from the main loop once the process exits, using a pidfd. If the process is already
+    // gone func is called on the next iteration. Returns an empty connection if pidfds are unsupported.
+    sigc::connection watch_process(int pid, const sigc::slot<void()> &func);
+} // namespace Askpass
+
+#endif
\ No newline at end of file
@@ -0,0 +1,156 @@
+#ifndef REQUEST_QUEUE_H
+#define REQUEST_QUEUE_H
+
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Askpass {
+    enum class QueuePolicy { Fifo, EarliestDeadline };
+
+    // Pending requests in scheduling order, with a second index by deadline for eager expiry.
+    // Lookup and cancellation by key are O(1), insertion and dequeue O(log n). A deadline of zero
+    // means the request never expires. Ties are broken by insertion order.
+    template<class K, class V>
+    class RequestQueue {
+        struct Node;
+        using entry_type = std::pair<const K, Node>;
+
+        struct PolicyOrder {
+            QueuePolicy policy;
+
+            bool operator()(const entry_type *lhs, const entry_type *rhs) const noexcept;
+        };
+
+        struct DeadlineOrder {
+            bool operator()(const entry_type *lhs, const entry_type *rhs) const noexcept;
+        };
+
+        using order_set    = std::set<entry_type *, PolicyOrder>;
+        using deadline_set = std::set<entry_type *, DeadlineOrder>;
+
+        struct Node {
+            V value;
+            time_t deadline;
+            std::uint64_t sequence;
+            typename order_set::iterator order_position {};
+            typename deadline_set::iterator deadline_position {};
+        };
+
+        std::unordered_map<K, Node> m_entries {};
+        order_set m_order;
+        deadline_set m_deadlines {};
+        std::uint64_t m_next_sequence {0};
+
+        std::pair<K, V> extract(entry_type *entry) {
+            m_order.erase(entry->second.order_position);
+            if (entry->second.deadline != 0) {
+                m_deadlines.erase(entry->second.deadline_position);
+            }
+            auto node = m_entries.extract(entry->first);
+            return {std::move(node.key()), std::move(node.mapped().value)};
+        }
+
+    public:
+        explicit RequestQueue(QueuePolicy policy = QueuePolicy::EarliestDeadline) : m_order(PolicyOrder {policy}) {}
+
+        RequestQueue(const RequestQueue &) = delete;
+
+        bool push(K key, V value, time_t deadline) {
+            auto [it, inserted] = m_entries.try_emplace(std::move(key), Node {std::move(value), deadline, m_next_sequence});
+            if (!inserted) {
+                return false;
+            }
+            ++m_next_sequence;
+            entry_type *entry            = &*it;
+            entry->second.order_position = m_order.insert(entry).first;
+            if (deadline != 0) {
+                entry->second.deadline_position = m_deadlines.insert(entry).first;
+            }
+            return true;
+        }
+
+        bool contains(const K &key) const { return m_entries.contains(key); }
+
+        bool remove(const K &key) {
+            auto it = m_entries.find(key);
+            if (it == m_entries.end()) {
+                return false;
+            }
+            extract(&*it);
+            return true;
+        }
+
+        std::pair<K, V> pop() {
+            if (empty()) {
+                throw std::runtime_error("dequeue while queue is empty");
+            }
+            return extract(*m_order.begin());
+        }
+
+        // Removes every request matching pred, in scheduling order
+        template<class Pred>
+        std::vector<std::pair<K, V>> extract_if(Pred &&pred) {
+            std::vector<entry_type *> matches;
+            for (entry_type *entry : m_order) {
+                if (pred(entry->first, entry->second.value)) {
+                    matches.push_back(entry);
+                }
+            }
+            std::vector<std::pair<K, V>> result;
+            result.reserve(matches.size());
+            for (entry_type *entry : matches) {
+                result.push_back(extract(entry));
+            }
+            return result;
+        }
+
+        // Removes every request whose deadline is not after now, in deadline order
+        template<class Func>
+        void expire(time_t now, Func &&on_expired) {
+            while (!m_deadlines.empty() && (*m_deadlines.begin())->second.deadline <= now) {
+                auto [key, value] = extract(*m_deadlines.begin());
+                on_expired(key, value);
+            }
+        }
+
+        // The earliest deadline of all queued requests, or zero if none of them expires
+        time_t next_deadline() const noexcept {
+            return m_deadlines.empty() ? 0 : (*m_deadlines.begin())->second.deadline;
+        }
+
+        bool empty() const noexcept { return m_entries.empty(); }
+
+        std::size_t size() const noexcept { return m_entries.size(); }
+    };
+
+    template<class K, class V>
+    bool RequestQueue<K, V>::PolicyOrder::operator()(const entry_type *lhs, const entry_type *rhs) const noexcept {
+        if (policy == QueuePolicy::EarliestDeadline) {
+            auto effective_deadline = [](const Node &node) {
+                return node.deadline != 0 ? node.deadline : std::numeric_limits<time_t>::max();
+            };
+            time_t lhs_deadline = effective_deadline(lhs->second);
+            time_t rhs_deadline = effective_deadline(rhs->second);
+            if (lhs_deadline != rhs_deadline) {
+                return lhs_deadline < rhs_deadline;
+            }
+        }
+        return lhs->second.sequence < rhs->second.sequence;
+    }
+
+    template<class K, class V>
+    bool RequestQueue<K, V>::DeadlineOrder::operator()(const entry_type *lhs, const entry_type *rhs) const noexcept {
+        if (lhs->second.deadline != rhs->second.deadline) {
+            return lhs->second.deadline < rhs->second.deadline;
+        }
+        return lhs->second.sequence < rhs->second.sequence;
+    }
+} // namespace Askpass
+
+#endif
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef REQUEST_SOCKET_H
+#define REQUEST_SOCKET_H
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <string_view>
+
+#include <glibmm.h>
+
+#include "systemd-askpass-context.h"
+#include "unique_fd.h"
+#include "unix-listener.h"
+
+namespace Askpass {
+    // Ids of socket requests in traces, kept apart from those of ask files
+    inline constexpr std::uint64_t SocketRequestIdBase = std::uint64_t(1) << 63;
+
+    // Takes requests on a SOCK_SEQPACKET unix socket without going through ask files. A client
+    // sends one packet in the ask file format, where PID= and Socket= are ignored, and gets the
+    // answer on the same connection: one packet of '+' and the password, or just '-' when the
+    // user cancelled. Requests which time out or whose process exits are closed without an answer.
+    class RequestSocket {
+        struct pending_connection {
+            wrapper::unique_fd fd;
+            sigc::scoped_connection watch {};
+        };
+
+        std::filesystem::path m_path;
+        UnixListener m_listener;
+        // Accepted connections whose request hasn't arrived yet
+        std::list<pending_connection> m_pending {};
+        sigc::signal<void(std::unique_ptr<SystemdAskpassContext> &)> m_signal_request {};
+        std::uint64_t m_next_request_id {SocketRequestIdBase};
+
+        void on_accepted(wrapper::unique_fd &fd);
+        bool on_connection_io(std::list<pending_connection>::iterator connection, Glib::IOCondition);
+        void receive_request(wrapper::unique_fd connection, std::string_view request);
+
+    public:
+        // Replaces a stale socket at path. Throws std::system_error if it can't listen there.
+        explicit RequestSocket(std::filesystem::path path);
+
+        RequestSocket(const RequestSocket &) = delete;
+
+        ~RequestSocket();
+
+        sigc::signal<void(std::unique_ptr<SystemdAskpassContext> &)> signal_request() noexcept {
+            return m_signal_request;
+        }
+    };
+} // namespace Askpass
+
+#endif
\ No newline at end of file
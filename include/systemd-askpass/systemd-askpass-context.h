@@ -1,31 +1,52 @@
 #ifndef SYSTEMD_ASKPASS_CONTEXT_H
 #define SYSTEMD_ASKPASS_CONTEXT_H
 
+#include <cstdint>
 #include <ctime>
 #include <memory>
 #include <string>
+#include <string_view>
 
+#include "ask-file-parser.h"
 #include "unique_fd.h"
 
 namespace Askpass {
     class SystemdAskpassContext {
         std::string m_message;
+        std::string m_id;
         int m_pid;
         wrapper::unique_fd m_answer_socket;
         time_t m_timeout;
+        bool m_echo;
+        bool m_accept_cached;
+        std::uint64_t m_request_id;
 
     public:
-        SystemdAskpassContext(std::string m_message, int m_pid, wrapper::unique_fd m_answer_socket, time_t m_timeout);
+        SystemdAskpassContext(const AskFile &ask_file, wrapper::unique_fd m_answer_socket, std::uint64_t m_request_id);
 
         constexpr std::string_view message() const noexcept { return m_message; }
 
+        constexpr std::string_view id() const noexcept { return m_id; }
+
         constexpr int pid() const noexcept { return m_pid; }
 
         constexpr time_t timeout() const noexcept { return m_timeout; }
 
+        constexpr bool echo() const noexcept { return m_echo; }
+
+        constexpr bool accept_cached() const noexcept { return m_accept_cached; }
+
         constexpr int answer_socket() const noexcept { return m_answer_socket.get(); }
 
-        static std::unique_ptr<SystemdAskpassContext> from_askpass_file(std::basic_istream<char> &askpass_file);
+        // Identifies the request in traces
+        constexpr std::uint64_t request_id() const noexcept { return m_request_id; }
+
+        static std::unique_ptr<SystemdAskpassContext> from_askpass_file(
+            std::string_view askpass_file, std::uint64_t request_id = 0);
+
+        // The answer is sent on connection, a SOCK_SEQPACKET socket of the process pid
+        static std::unique_ptr<SystemdAskpassContext> from_request(
+            std::string_view request, wrapper::unique_fd connection, int pid, std::uint64_t request_id = 0);
     };
 } // namespace Askpass
 
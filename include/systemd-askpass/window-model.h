@@ -1,24 +1,42 @@
 #ifndef WINDOW_MODEL_H
 #define WINDOW_MODEL_H
 
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <string_view>
+#include <vector>
 
 #include <sigc++/signal.h>
 
 #include "concepts.h"
 #include "exit_codes.h"
+#include "output-sink.h"
 #include "systemd-askpass-context.h"
 
 namespace Askpass {
+    // One prompt answering one or more requests. All requests receive the same answer.
     class WindowModel : public sigc::trackable {
-        std::unique_ptr<SystemdAskpassContext> m_context;
+        std::vector<std::unique_ptr<SystemdAskpassContext>> m_contexts;
+        std::string m_message;
         ExitCode m_exit_status {0};
+        // Seconds entered answers are cached in the keyring, zero disables caching
+        unsigned int m_cache_timeout;
+        // Answers are written to all sockets at once, the exit status is set when the last one is done
+        std::vector<std::unique_ptr<OutputSink>> m_sinks {};
+        std::size_t m_pending_writes {0};
+        ExitCode m_pending_exit_status {0};
+        sigc::signal<void(void)> m_signal_written {};
+        bool m_answered {false};
 
+        void write_answers(char status, std::string_view input, ExitCode exit_status);
+        void on_answer_written(std::uint64_t request_id, int error);
         void on_succeeded(std::string_view input);
         void on_failure();
+        void update_message();
 
     public:
-        explicit WindowModel(std::unique_ptr<SystemdAskpassContext> context);
+        explicit WindowModel(std::unique_ptr<SystemdAskpassContext> context, unsigned int cache_timeout = 0);
 
         WindowModel(const WindowModel &) = delete;
 
@@ -27,9 +45,29 @@ namespace Askpass {
             window.signal_failure().connect(sigc::mem_fun(*this, &WindowModel::on_failure));
         }
 
-        std::string_view message() const noexcept { return m_context->message(); }
+        // Answers all requests without a prompt, with an answer taken from the keyring
+        void answer_from_cache(std::string_view answer);
 
-        time_t timeout() const noexcept { return m_context->timeout(); }
+        void add_context(std::unique_ptr<SystemdAskpassContext> context);
+
+        void remove_context(std::size_t index);
+
+        const SystemdAskpassContext &context(std::size_t index) const noexcept { return *m_contexts[index]; }
+
+        std::size_t size() const noexcept { return m_contexts.size(); }
+
+        std::string_view message() const noexcept { return m_message; }
+
+        // The earliest deadline of all requests, or zero if none of them expires
+        time_t timeout() const noexcept;
+
+        // Whether the requests were answered or cancelled, by the user or from the keyring
+        bool is_answered() const noexcept { return m_answered; }
+
+        // Whether answers are still being written. Closing a request's socket doesn't cancel its write.
+        bool is_writing() const noexcept { return m_pending_writes != 0; }
+
+        sigc::signal<void(void)> signal_written() noexcept { return m_signal_written; }
 
         constexpr ExitCode exit_status() const noexcept { return m_exit_status; }
     };
@@ -0,0 +1,34 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Askpass {
+    // A fixed set of threads running jobs in submission order. Jobs that still wait when the pool is
+    // destroyed are dropped, running ones are joined.
+    class WorkerPool {
+        std::mutex m_mutex {};
+        std::condition_variable m_condition {};
+        std::deque<std::function<void()>> m_jobs {};
+        bool m_stopping {false};
+        std::vector<std::jthread> m_threads {};
+
+        void run();
+
+    public:
+        explicit WorkerPool(unsigned int thread_count);
+
+        WorkerPool(const WorkerPool &) = delete;
+
+        ~WorkerPool();
+
+        void submit(std::function<void()> job);
+    };
+} // namespace Askpass
+
+#endif
\ No newline at end of file
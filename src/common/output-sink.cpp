@@ -0,0 +1,104 @@
+#include "output-sink.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+    // An answer is a status byte or exit code plus the password
+    constexpr std::size_t MaxParts = 2;
+} // namespace
+
+namespace Askpass {
+    void OutputSink::set_non_blocking(int fd) {
+        int flags = fcntl(fd, F_GETFL);
+        if (flags >= 0 && !(flags & O_NONBLOCK) && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0) {
+            m_restore_flags = flags;
+        }
+    }
+
+    void OutputSink::restore_flags(int fd) {
+        // The flags belong to the open file description, which others may share
+        if (m_restore_flags >= 0) {
+            fcntl(fd, F_SETFL, m_restore_flags);
+            m_restore_flags = -1;
+        }
+    }
+
+    void OutputSink::finish(int fd, int error) {
+        restore_flags(fd);
+        m_io_watch.disconnect();
+        m_pending.reset();
+        m_fd.reset();
+        m_writing = false;
+        // The handler may destroy this sink, so nothing may follow the emission
+        m_signal_done.emit(error);
+    }
+
+    void OutputSink::write(int fd, std::initializer_list<std::string_view> parts) {
+        std::array<iovec, MaxParts> vecs {};
+        std::size_t count = 0;
+        std::size_t total = 0;
+        for (std::string_view part : parts) {
+            if (count < vecs.size()) {
+                vecs[count++] = iovec {const_cast<char *>(part.data()), part.size()};
+                total += part.size();
+            }
+        }
+
+        m_writing = true;
+        set_non_blocking(fd);
+        ssize_t result;
+        do {
+            result = writev(fd, vecs.data(), static_cast<int>(count));
+        } while (result < 0 && errno == EINTR);
+
+        if (result >= 0 && static_cast<std::size_t>(result) == total) {
+            return finish(fd, 0);
+        } else if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            return finish(fd, errno);
+        }
+
+        // Keep the rest, the caller's data may be gone by the time the fd becomes writable
+        std::size_t skip = static_cast<std::size_t>(std::max<ssize_t>(result, 0));
+        m_pending        = std::make_unique<SecureBuffer>(total - skip);
+        for (std::size_t i = 0; i < count; ++i) {
+            std::string_view part {static_cast<const char *>(vecs[i].iov_base), vecs[i].iov_len};
+            std::size_t skipped = std::min(skip, part.size());
+            skip -= skipped;
+            m_pending->insert(m_pending->size(), part.substr(skipped));
+        }
+
+        m_fd = wrapper::unique_fd {fcntl(fd, F_DUPFD_CLOEXEC, 0)};
+        if (m_fd.get() < 0) {
+            return finish(fd, errno);
+        }
+        m_io_watch = Glib::signal_io().connect(sigc::mem_fun(*this, &OutputSink::on_writable), m_fd.get(),
+            Glib::IOCondition::IO_OUT | Glib::IOCondition::IO_ERR | Glib::IOCondition::IO_HUP);
+    }
+
+    bool OutputSink::on_writable(Glib::IOCondition) {
+        ssize_t result = ::write(m_fd.get(), m_pending->data(), m_pending->size());
+        if (result < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+
+        // Returning false removes the source, so it must not be disconnected while it is running.
+        if (result < 0) {
+            m_io_watch.release();
+            finish(m_fd.get(), errno);
+            return false;
+        }
+        m_pending->erase(0, static_cast<std::size_t>(result));
+        if (m_pending->size() == 0) {
+            m_io_watch.release();
+            finish(m_fd.get(), 0);
+            return false;
+        }
+        return true;
+    }
+} // namespace Askpass
@@ -0,0 +1,49 @@
+#include "platform.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include <dlfcn.h>
+
+#include "exit_codes.h"
+
+namespace {
+    constexpr char PlatformDirVariable[] = "WAYLAND_ASKPASS_PLATFORM_DIR";
+    constexpr char SetupSymbol[]         = "askpass_platform_setup";
+
+    std::string get_module_path(std::string_view platform) {
+        const char *directory = getenv(PlatformDirVariable);
+        std::string path      = directory != nullptr ? directory : ASKPASS_PLATFORM_DIR;
+        path.append("/libaskpass-platform-").append(platform).append(".so");
+        return path;
+    }
+
+    askpass_platform_setup_func_t *load_module(std::string_view platform) {
+        std::string path = get_module_path(platform);
+        // Modules stay loaded, the X11 one keeps signal handlers connected to the display
+        void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (handle == nullptr) {
+            std::cerr << "Failed to load platform module: " << dlerror() << '\n';
+            Askpass::exit(Askpass::ExitCode::InvalidPlatform);
+        }
+        auto setup = reinterpret_cast<askpass_platform_setup_func_t *>(dlsym(handle, SetupSymbol));
+        if (setup == nullptr) {
+            std::cerr << "Invalid platform module " << path << '\n';
+            Askpass::exit(Askpass::ExitCode::InvalidPlatform);
+        }
+        return setup;
+    }
+} // namespace
+
+namespace Askpass {
+    void platform_setup(std::string_view platform, Gtk::Window &window) {
+        static std::map<std::string, askpass_platform_setup_func_t *, std::less<>> modules;
+        auto it = modules.find(platform);
+        if (it == modules.end()) {
+            it = modules.emplace(std::string(platform), load_module(platform)).first;
+        }
+        it->second(window.gobj());
+    }
+} // namespace Askpass
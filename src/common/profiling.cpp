@@ -0,0 +1,81 @@
+#include "profiling.h"
+
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+
+namespace {
+    constexpr char ProfileVariable[] = "WAYLAND_ASKPASS_PROFILE";
+
+    std::string_view get_variable(const char *name) {
+        const char *variable = getenv(name);
+        return variable != nullptr ? variable : "";
+    }
+
+    long long clock_us(clockid_t clock) {
+        timespec ts {};
+        clock_gettime(clock, &ts);
+        return static_cast<long long>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    }
+
+    // The kernel records the start of the process in clock ticks of CLOCK_BOOTTIME, which is
+    // translated to CLOCK_MONOTONIC. The resolution is a clock tick, usually 10ms.
+    long long get_exec_time() {
+        std::ifstream stat_file {"/proc/self/stat"};
+        std::string stat {std::istreambuf_iterator<char>(stat_file), {}};
+        // The command name may contain spaces, the fields after it don't
+        auto fields_begin = stat.rfind(')');
+        if (fields_begin == std::string::npos) {
+            return clock_us(CLOCK_MONOTONIC);
+        }
+        std::istringstream fields {stat.substr(fields_begin + 1)};
+        std::string field;
+        // starttime is the 22nd field, the 20th after the command name
+        for (int i = 0; i < 20 && fields >> field; ++i) {}
+        long long start_ticks = 0;
+        if (!(fields >> start_ticks)) {
+            return clock_us(CLOCK_MONOTONIC);
+        }
+        long long start_boottime = start_ticks * 1000000 / sysconf(_SC_CLK_TCK);
+        return clock_us(CLOCK_MONOTONIC) - (clock_us(CLOCK_BOOTTIME) - start_boottime);
+    }
+
+    // The resident set in kB, including the libraries mapped so far
+    long long get_rss_kb() {
+        std::ifstream statm_file {"/proc/self/statm"};
+        long long size_pages     = 0;
+        long long resident_pages = 0;
+        if (!(statm_file >> size_pages >> resident_pages)) {
+            return 0;
+        }
+        return resident_pages * sysconf(_SC_PAGESIZE) / 1024;
+    }
+} // namespace
+
+namespace Askpass {
+    bool is_profiling_enabled() {
+        static const bool enabled = !get_variable(ProfileVariable).empty() && get_variable(ProfileVariable) != "0";
+        return enabled;
+    }
+
+    bool is_cancel_after_first_frame_enabled() {
+        return get_variable(ProfileVariable) == "cancel";
+    }
+
+    void mark_phase(const char *phase) {
+        if (!is_profiling_enabled()) {
+            return;
+        }
+        static const long long exec_time = get_exec_time();
+        long long now                    = clock_us(CLOCK_MONOTONIC);
+        std::cerr << "askpass-profile phase=" << phase << " monotonic_us=" << now
+                  << " since_exec_us=" << now - exec_time << " rss_kb=" << get_rss_kb()
+                  << std::endl;
+    }
+} // namespace Askpass
@@ -0,0 +1,62 @@
+#include "secure-buffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "macros.h"
+
+namespace {
+    std::size_t round_to_pages(std::size_t size) {
+        const auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        return (size + page_size - 1) / page_size * page_size;
+    }
+} // namespace
+
+namespace Askpass {
+    SecureBuffer::SecureBuffer(std::size_t capacity) : m_mapping_size(round_to_pages(capacity + 1)) {
+        void *data = mmap(nullptr, m_mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        throw_system_error_if(data == MAP_FAILED);
+        m_data = static_cast<char *>(data);
+        // Failing to lock (RLIMIT_MEMLOCK) only loses the swap protection
+        if (mlock(m_data, m_mapping_size) < 0) {
+            std::cerr << "Failed to lock the password buffer into memory\n";
+        }
+        madvise(m_data, m_mapping_size, MADV_DONTDUMP);
+    }
+
+    SecureBuffer::~SecureBuffer() {
+        explicit_bzero(m_data, m_mapping_size);
+        munlock(m_data, m_mapping_size);
+        munmap(m_data, m_mapping_size);
+    }
+
+    bool SecureBuffer::insert(std::size_t offset, std::string_view bytes) noexcept {
+        if (offset > m_size || bytes.size() > capacity() - m_size) {
+            return false;
+        }
+        std::memmove(m_data + offset + bytes.size(), m_data + offset, m_size - offset);
+        std::memcpy(m_data + offset, bytes.data(), bytes.size());
+        m_size += bytes.size();
+        return true;
+    }
+
+    void SecureBuffer::erase(std::size_t offset, std::size_t count) noexcept {
+        offset = std::min(offset, m_size);
+        count  = std::min(count, m_size - offset);
+        std::memmove(m_data + offset, m_data + offset + count, m_size - offset - count);
+        resize(m_size - count);
+    }
+
+    void SecureBuffer::resize(std::size_t size) noexcept {
+        size = std::min(size, capacity());
+        if (size < m_size) {
+            explicit_bzero(m_data + size, m_size - size);
+        }
+        m_size         = size;
+        m_data[m_size] = '\0';
+    }
+} // namespace Askpass
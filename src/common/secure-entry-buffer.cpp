@@ -0,0 +1,114 @@
+#include "secure-entry-buffer.h"
+
+#include <algorithm>
+#include <string_view>
+
+#include "secure-buffer.h"
+
+namespace {
+    struct SecureEntryBuffer {
+        GtkEntryBuffer parent_instance;
+        Askpass::SecureBuffer *storage;
+        guint length;
+    };
+
+    struct SecureEntryBufferClass {
+        GtkEntryBufferClass parent_class;
+    };
+
+    G_DEFINE_TYPE(SecureEntryBuffer, secure_entry_buffer, GTK_TYPE_ENTRY_BUFFER)
+
+    SecureEntryBuffer *to_secure_entry_buffer(GtkEntryBuffer *buffer) {
+        return G_TYPE_CHECK_INSTANCE_CAST(buffer, secure_entry_buffer_get_type(), SecureEntryBuffer);
+    }
+
+    // Byte offset of the character at position
+    std::size_t byte_offset(const Askpass::SecureBuffer &storage, guint position) {
+        return g_utf8_offset_to_pointer(storage.data(), position) - storage.data();
+    }
+
+    const char *get_text(GtkEntryBuffer *buffer, gsize *n_bytes) {
+        auto self = to_secure_entry_buffer(buffer);
+        if (n_bytes != nullptr) {
+            *n_bytes = self->storage->size();
+        }
+        return self->storage->data();
+    }
+
+    guint get_length(GtkEntryBuffer *buffer) {
+        return to_secure_entry_buffer(buffer)->length;
+    }
+
+    guint insert_text(GtkEntryBuffer *buffer, guint position, const char *chars, guint n_chars) {
+        auto self   = to_secure_entry_buffer(buffer);
+        position    = std::min(position, self->length);
+        auto offset = byte_offset(*self->storage, position);
+
+        // Characters that don't fit anymore are dropped
+        std::size_t available = self->storage->capacity() - self->storage->size();
+        std::size_t n_bytes   = 0;
+        guint inserted        = 0;
+        while (inserted < n_chars) {
+            std::size_t next = g_utf8_next_char(chars + n_bytes) - chars;
+            if (next > available) {
+                break;
+            }
+            n_bytes = next;
+            ++inserted;
+        }
+        if (inserted == 0) {
+            return 0;
+        }
+
+        self->storage->insert(offset, std::string_view(chars, n_bytes));
+        self->length += inserted;
+        gtk_entry_buffer_emit_inserted_text(buffer, position, chars, inserted);
+        return inserted;
+    }
+
+    guint delete_text(GtkEntryBuffer *buffer, guint position, guint n_chars) {
+        auto self = to_secure_entry_buffer(buffer);
+        position  = std::min(position, self->length);
+        n_chars   = std::min(n_chars, self->length - position);
+        if (n_chars == 0) {
+            return 0;
+        }
+
+        auto begin = byte_offset(*self->storage, position);
+        auto end   = byte_offset(*self->storage, position + n_chars);
+        self->storage->erase(begin, end - begin);
+        self->length -= n_chars;
+        gtk_entry_buffer_emit_deleted_text(buffer, position, n_chars);
+        return n_chars;
+    }
+
+    void secure_entry_buffer_finalize(GObject *object) {
+        delete to_secure_entry_buffer(GTK_ENTRY_BUFFER(object))->storage;
+        G_OBJECT_CLASS(secure_entry_buffer_parent_class)->finalize(object);
+    }
+
+    void secure_entry_buffer_init(SecureEntryBuffer *self) {
+        self->storage = new Askpass::SecureBuffer();
+        self->length  = 0;
+    }
+
+    void secure_entry_buffer_class_init(SecureEntryBufferClass *klass) {
+        G_OBJECT_CLASS(klass)->finalize = secure_entry_buffer_finalize;
+
+        auto buffer_class         = GTK_ENTRY_BUFFER_CLASS(klass);
+        buffer_class->get_text    = get_text;
+        buffer_class->get_length  = get_length;
+        buffer_class->insert_text = insert_text;
+        buffer_class->delete_text = delete_text;
+    }
+} // namespace
+
+namespace Askpass {
+    void use_secure_entry_buffer(Gtk::PasswordEntry &entry) {
+        // The entry's editing happens in its GtkText delegate, which owns the buffer
+        GtkEditable *text = gtk_editable_get_delegate(entry.Gtk::Editable::gobj());
+        auto buffer       = static_cast<GtkEntryBuffer *>(g_object_new(secure_entry_buffer_get_type(), nullptr));
+        gtk_text_set_buffer(GTK_TEXT(text), buffer);
+        g_object_unref(buffer);
+    }
+} // namespace Askpass
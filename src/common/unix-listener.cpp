@@ -0,0 +1,79 @@
+#include "unix-listener.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "macros.h"
+
+namespace {
+    // Milliseconds until a listener is watched again after accepting failed
+    constexpr unsigned int AcceptRetryInterval = 1000;
+} // namespace
+
+namespace Askpass {
+    sockaddr_un make_unix_address(const std::filesystem::path &path) {
+        sockaddr_un res {};
+        res.sun_family = AF_UNIX;
+        const std::string &native = path.native();
+        // We need the last character as null-terminator
+        if (native.size() >= sizeof(res.sun_path)) {
+            throw std::system_error(ENAMETOOLONG, std::system_category());
+        }
+        std::memcpy(res.sun_path, native.data(), native.size());
+        return res;
+    }
+
+    wrapper::unique_fd listen_unix_socket(const std::filesystem::path &path, int type) {
+        const sockaddr_un addr = make_unix_address(path);
+        wrapper::unique_fd s {socket(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)};
+        throw_system_error_if(s.get() < 0);
+        unlink(path.c_str());
+        throw_system_error_if(bind(s.get(), reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) < 0);
+        throw_system_error_if(listen(s.get(), SOMAXCONN) < 0);
+        return s;
+    }
+
+    UnixListener::UnixListener(
+        wrapper::unique_fd fd, int accept_flags, const sigc::slot<void(wrapper::unique_fd &)> &on_accepted) :
+            m_fd(std::move(fd)), m_accept_flags(accept_flags | SOCK_CLOEXEC), m_on_accepted(on_accepted) {
+        // Accepting stops at an empty backlog instead of blocking the main loop
+        int flags = fcntl(m_fd.get(), F_GETFL);
+        if (flags >= 0 && (flags & O_NONBLOCK) == 0) {
+            fcntl(m_fd.get(), F_SETFL, flags | O_NONBLOCK);
+        }
+        watch();
+    }
+
+    void UnixListener::watch() {
+        m_watch = Glib::signal_io().connect(
+            sigc::mem_fun(*this, &UnixListener::on_io), m_fd.get(), Glib::IOCondition::IO_IN);
+    }
+
+    bool UnixListener::on_io(Glib::IOCondition) {
+        while (true) {
+            wrapper::unique_fd connection {accept4(m_fd.get(), nullptr, nullptr, m_accept_flags)};
+            if (connection.get() >= 0) {
+                m_on_accepted(connection);
+                continue;
+            }
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+            std::cerr << "Accepting a connection failed: " << std::system_category().message(errno) << '\n';
+            m_watch.release();
+            m_retry_timeout
+                = Glib::signal_timeout().connect_once(sigc::mem_fun(*this, &UnixListener::watch), AcceptRetryInterval);
+            return false;
+        }
+    }
+} // namespace Askpass
\ No newline at end of file
@@ -7,6 +7,8 @@
 # include <gdk/wayland/gdkwayland.h>
 # include <gtk4-layer-shell.h>
 
+# include "platform.h"
+
 namespace {
     constexpr const char LAYER_NAMESPACE[]            = "Password Dialog";
     constexpr GtkLayerShellLayer LAYER                = GTK_LAYER_SHELL_LAYER_OVERLAY;
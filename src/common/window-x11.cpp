@@ -2,12 +2,21 @@
 
 #ifdef GDK_WINDOWING_X11
 
+# include <algorithm>
 # include <array>
+# include <cstdint>
+# include <cstdlib>
 # include <iostream>
+# include <optional>
 # include <span>
 
 # include <X11/Xatom.h>
+# include <X11/Xlib-xcb.h>
 # include <gdk/x11/gdkx.h>
+# include <xcb/xcb.h>
+# include <xcb/xcbext.h>
+
+# include "platform.h"
 
 namespace {
     // X11 stuff
@@ -29,11 +38,52 @@ namespace {
         "_NET_WM_STATE_MODAL"};
     static_assert(ATOMS_MAX == NEEDED_ATOMS.size());
 
-    std::array<Atom, ATOMS_MAX> get_atoms(Display *xdisplay) {
-        std::array<Atom, ATOMS_MAX> buffer {};
+    using AtomCache = std::array<Atom, ATOMS_MAX>;
+
+    // Milliseconds. Retries start quickly, as the window manager usually maps its frame right
+    // after the window.
+    constexpr guint ReplyPollInterval = 2;
+    constexpr guint InitialRetryDelay = 10;
+    constexpr guint MaxRetryDelay     = 1000;
+
+    // Everything
+    constexpr std::uint16_t GrabMask
+        = ButtonPressMask
+          | ButtonReleaseMask
+          | EnterWindowMask
+          | LeaveWindowMask
+          | PointerMotionMask
+          | PointerMotionHintMask
+          | Button1MotionMask
+          | Button2MotionMask
+          | Button3MotionMask
+          | Button4MotionMask
+          | Button5MotionMask
+          | ButtonMotionMask
+          | KeymapStateMask;
+
+    GQuark get_atoms_quark() {
+        static const GQuark quark = g_quark_from_static_string("askpass-x11-atoms");
+        return quark;
+    }
+
+    GQuark get_grab_manager_quark() {
+        static const GQuark quark = g_quark_from_static_string("askpass-x11-grab-manager");
+        return quark;
+    }
+
+    // Interned with one round trip for the first window of a display and kept with the display
+    const AtomCache &get_atoms(GdkDisplay *display, Display *xdisplay) {
+        if (auto atoms = static_cast<const AtomCache *>(g_object_get_qdata(G_OBJECT(display), get_atoms_quark()))) {
+            return *atoms;
+        }
+        auto atoms = new AtomCache {};
         // XInternAtoms is broken and requested a char**
-        XInternAtoms(xdisplay, const_cast<char **>(NEEDED_ATOMS.data()), ATOMS_MAX, false, buffer.data());
-        return buffer;
+        XInternAtoms(xdisplay, const_cast<char **>(NEEDED_ATOMS.data()), ATOMS_MAX, false, atoms->data());
+        g_object_set_qdata_full(G_OBJECT(display), get_atoms_quark(), atoms, [](gpointer data) {
+            delete static_cast<AtomCache *>(data);
+        });
+        return *atoms;
     }
 
     void set_atom(Display *xdisplay, Window xwindow, Atom key, std::span<const Atom> values) {
@@ -51,60 +101,174 @@ namespace {
         set_atom(xdisplay, xwindow, key, values);
     }
 
-    void grab_keyboard(Display *xdisplay, Window xwindow) {
-        if (auto res = XGrabKeyboard(xdisplay, xwindow, True, GrabModeAsync, GrabModeAsync, CurrentTime);
-            res != GrabSuccess) {
-            std::cerr << "Failed to grab keyboard focus";
-            exit(EXIT_FAILURE);
+    // Returns whether the reply to request has arrived, setting grabbed to the outcome
+    bool poll_grab_reply(xcb_connection_t *connection, std::optional<unsigned int> &request, bool &grabbed) {
+        if (!request) {
+            return true;
+        }
+        void *reply                = nullptr;
+        xcb_generic_error_t *error = nullptr;
+        if (xcb_poll_for_reply(connection, *request, &reply, &error) == 0) {
+            return false;
         }
+        // Keyboard and pointer grab replies share their layout
+        grabbed = reply != nullptr
+                  && static_cast<xcb_grab_keyboard_reply_t *>(reply)->status == XCB_GRAB_STATUS_SUCCESS;
+        free(reply);
+        free(error);
+        request.reset();
+        return true;
     }
 
-    void grab_pointer(Display *xdisplay, Window xwindow) {
-        // Everything
-        constexpr int GrabMask
-            = ButtonPressMask
-              | ButtonReleaseMask
-              | EnterWindowMask
-              | LeaveWindowMask
-              | PointerMotionMask
-              | PointerMotionHintMask
-              | Button1MotionMask
-              | Button2MotionMask
-              | Button3MotionMask
-              | Button4MotionMask
-              | Button5MotionMask
-              | ButtonMotionMask
-              | KeymapStateMask;
-        if (auto res = XGrabPointer(xdisplay, xwindow, True, GrabMask, GrabModeAsync, GrabModeAsync, None, None, CurrentTime);
-            res != GrabSuccess) {
-            std::cerr << "Failed to grab keyboard focus";
-            exit(EXIT_FAILURE);
+    // Grabs keyboard and pointer once per map of the window. The requests are sent through XCB,
+    // so the main loop doesn't wait for the X server. Grabs which fail, e.g. while the frame
+    // isn't mapped yet or another client holds a grab, are retried with a growing delay until
+    // they succeed or the window is unmapped.
+    class GrabManager {
+        GtkWidget *m_widget;
+        GdkDisplay *m_display;
+        xcb_connection_t *m_connection;
+        xcb_window_t m_window;
+        gulong m_xevent_handler;
+        gulong m_unrealize_handler;
+
+        guint m_timeout     = 0;
+        guint m_retry_delay = InitialRetryDelay;
+        std::optional<unsigned int> m_keyboard_request;
+        std::optional<unsigned int> m_pointer_request;
+        bool m_keyboard_grabbed = false;
+        bool m_pointer_grabbed  = false;
+        bool m_retry_due        = false;
+        bool m_failure_reported = false;
+
+    public:
+        GrabManager(GtkWidget *widget, GdkDisplay *display, Display *xdisplay, Window xwindow) :
+                m_widget(widget), m_display(display), m_connection(XGetXCBConnection(xdisplay)),
+                m_window(static_cast<xcb_window_t>(xwindow)) {
+            m_xevent_handler    = g_signal_connect(display, "xevent", G_CALLBACK(&GrabManager::on_xevent), this);
+            m_unrealize_handler = g_signal_connect(widget, "unrealize", G_CALLBACK(&GrabManager::on_unrealize), this);
         }
-    }
 
-    gboolean on_xevent(GdkX11Display *display, gpointer xevent, gpointer user_data) {
-        if (auto event = static_cast<XEvent *>(xevent); event->type == Expose) {
-            auto surface = static_cast<GdkSurface *>(user_data);
-# pragma GCC diagnostic push
-# pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-            auto xdisplay = gdk_x11_display_get_xdisplay(display);
-            auto xwindow  = gdk_x11_surface_get_xid(surface);
-# pragma GCC diagnostic pop
-            grab_keyboard(xdisplay, xwindow);
-            grab_pointer(xdisplay, xwindow);
+        GrabManager(const GrabManager &) = delete;
+
+        ~GrabManager() {
+            cancel();
+            g_signal_handler_disconnect(m_display, m_xevent_handler);
+            g_signal_handler_disconnect(m_widget, m_unrealize_handler);
         }
-        return false;
-    }
+
+    private:
+        static gboolean on_xevent(GdkX11Display *, gpointer xevent, gpointer user_data) {
+            auto &manager = *static_cast<GrabManager *>(user_data);
+            auto event    = static_cast<XEvent *>(xevent);
+            if (event->type == MapNotify && event->xmap.window == manager.m_window) {
+                manager.on_map();
+            } else if (event->type == UnmapNotify && event->xunmap.window == manager.m_window) {
+                manager.on_unmap();
+            }
+            return false;
+        }
+
+        // The XCB connection has to be left before the display may close
+        static void on_unrealize(GtkWidget *widget, gpointer) {
+            g_object_set_qdata(G_OBJECT(widget), get_grab_manager_quark(), nullptr);
+        }
+
+        static gboolean on_timeout(gpointer user_data) {
+            auto &manager     = *static_cast<GrabManager *>(user_data);
+            manager.m_timeout = 0;
+            manager.check_grabs();
+            return G_SOURCE_REMOVE;
+        }
+
+        void on_map() {
+            cancel();
+            m_retry_delay      = InitialRetryDelay;
+            m_failure_reported = false;
+            request_grabs();
+        }
+
+        // The server releases the grabs of windows which aren't viewable
+        void on_unmap() {
+            cancel();
+            m_keyboard_grabbed = false;
+            m_pointer_grabbed  = false;
+        }
+
+        void request_grabs() {
+            if (!m_keyboard_grabbed) {
+                auto cookie = xcb_grab_keyboard(
+                    m_connection, true, m_window, XCB_CURRENT_TIME, XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC);
+                m_keyboard_request = cookie.sequence;
+            }
+            if (!m_pointer_grabbed) {
+                auto cookie = xcb_grab_pointer(m_connection,
+                    true,
+                    m_window,
+                    GrabMask,
+                    XCB_GRAB_MODE_ASYNC,
+                    XCB_GRAB_MODE_ASYNC,
+                    XCB_NONE,
+                    XCB_NONE,
+                    XCB_CURRENT_TIME);
+                m_pointer_request = cookie.sequence;
+            }
+            xcb_flush(m_connection);
+            schedule(ReplyPollInterval);
+        }
+
+        void check_grabs() {
+            if (m_retry_due) {
+                m_retry_due = false;
+                return request_grabs();
+            }
+            const bool keyboard_replied = poll_grab_reply(m_connection, m_keyboard_request, m_keyboard_grabbed);
+            const bool pointer_replied  = poll_grab_reply(m_connection, m_pointer_request, m_pointer_grabbed);
+            if (!keyboard_replied || !pointer_replied) {
+                return schedule(ReplyPollInterval);
+            }
+            if (m_keyboard_grabbed && m_pointer_grabbed) {
+                return;
+            }
+            if (!m_failure_reported) {
+                std::cerr << "Failed to grab " << (m_keyboard_grabbed ? "the pointer" : "keyboard focus")
+                          << ", retrying\n";
+                m_failure_reported = true;
+            }
+            m_retry_due = true;
+            schedule(m_retry_delay);
+            m_retry_delay = std::min(m_retry_delay * 2, MaxRetryDelay);
+        }
+
+        void schedule(guint delay) {
+            m_timeout = g_timeout_add(delay, &GrabManager::on_timeout, this);
+        }
+
+        void cancel() {
+            if (m_timeout != 0) {
+                g_source_remove(m_timeout);
+                m_timeout = 0;
+            }
+            for (auto request : {&m_keyboard_request, &m_pointer_request}) {
+                if (*request) {
+                    xcb_discard_reply(m_connection, **request);
+                    request->reset();
+                }
+            }
+            m_retry_due = false;
+        }
+    };
 } // namespace
 
-void platform_setup_x11(Gtk::Window &window) {
+void askpass_platform_setup(GtkWindow *gobj) {
+    Gtk::Window &window = *Glib::wrap(gobj);
 # pragma GCC diagnostic push
 # pragma GCC diagnostic ignored "-Wdeprecated-declarations"
     auto xdisplay    = gdk_x11_display_get_xdisplay(window.get_display()->gobj());
     auto xrootwindow = gdk_x11_display_get_xrootwindow(window.get_display()->gobj());
     auto xwindow     = gdk_x11_surface_get_xid(window.get_surface()->gobj());
 
-    const auto atoms = get_atoms(xdisplay);
+    const auto &atoms = get_atoms(window.get_display()->gobj(), xdisplay);
 
     XSetTransientForHint(xdisplay, xwindow, xrootwindow);
     const std::array DesiredWindowStates {atoms[ATOMS_WM_STATE_ABOVE],
@@ -115,8 +279,11 @@ void platform_setup_x11(Gtk::Window &window) {
     auto x11_surface = GDK_X11_SURFACE(window.get_surface()->gobj());
     gdk_x11_surface_move_to_current_desktop(x11_surface);
 
-    GdkX11Display *x11_display = GDK_X11_DISPLAY(window.get_display()->gobj());
-    g_signal_connect_object(x11_display, "xevent", G_CALLBACK(&on_xevent), window.get_surface()->gobj(), G_CONNECT_DEFAULT);
+    // Replaces the manager of an earlier surface of this window
+    auto grab_manager = new GrabManager(GTK_WIDGET(gobj), window.get_display()->gobj(), xdisplay, xwindow);
+    g_object_set_qdata_full(G_OBJECT(gobj), get_grab_manager_quark(), grab_manager, [](gpointer data) {
+        delete static_cast<GrabManager *>(data);
+    });
 # pragma GCC diagnostic pop
 }
 
@@ -1,52 +1,32 @@
 #include "window.h"
 
+#include <cstdlib>
 #include <iostream>
 #include <string_view>
 
 #include <gdk/gdkkeysyms.h>
 
 #include "exit_codes.h"
+#include "platform.h"
+#include "secure-entry-buffer.h"
 
-#ifdef GDK_WINDOWING_WAYLAND
-# include <gdk/wayland/gdkwayland.h>
-
-void platform_setup_wayland(Gtk::Window &window);
-
-bool is_wayland_display(Gdk::Display *display) {
-    return GDK_IS_WAYLAND_DISPLAY(display->gobj());
-}
-#else
-[[maybe_unused]] void platform_setup_wayland(Gtk::Window &) {}
-
-bool is_wayland_display(Gdk::Display *) {
-    return false;
-}
-#endif
-
-#ifdef GDK_WINDOWING_X11
-# include <gdk/x11/gdkx.h>
-
-void platform_setup_x11(Gtk::Window &window);
-
-bool is_x11_display(Gdk::Display *display) {
-    return GDK_IS_X11_DISPLAY(display->gobj());
-}
-#else
-[[maybe_unused]] void platform_setup_x11(Gtk::Window &) {}
+namespace {
+    constexpr char NonUniqueVariable[] = "WAYLAND_ASKPASS_NON_UNIQUE";
 
-bool is_x11_display(Gdk::Display *) {
-    return false;
-}
-#endif
+    // Compared by type name, so the X11 library is only needed once its display is in use
+    bool is_display_type(Gdk::Display *display, std::string_view type_name) {
+        return type_name == G_OBJECT_TYPE_NAME(display->gobj());
+    }
 
-namespace {
     constexpr std::string_view Title = "Askpass";
 
     void platform_setup(Askpass::Window &window) {
-        if (is_wayland_display(window.get_display().get())) {
+        if (is_display_type(window.get_display().get(), "GdkWaylandDisplay")) {
+#ifdef GDK_WINDOWING_WAYLAND
             platform_setup_wayland(window);
-        } else if (is_x11_display(window.get_display().get())) {
-            platform_setup_x11(window);
+#endif
+        } else if (is_display_type(window.get_display().get(), "GdkX11Display")) {
+            Askpass::platform_setup("x11", window);
         } else {
             std::cerr << "Invalid gdk platform\n";
             exit(Askpass::ExitCode::InvalidPlatform);
@@ -64,6 +44,7 @@ namespace Askpass {
         m_password_entry.set_show_peek_icon(true);
         m_password_entry.set_enable_undo(false);
         m_password_entry.property_activates_default().set_value(true);
+        use_secure_entry_buffer(m_password_entry);
 
         m_cancel_button.set_label("Cancel");
         m_cancel_button.signal_clicked().connect(sigc::mem_fun(*this, &Window::on_cancle_button_clicked));
@@ -90,6 +71,7 @@ namespace Askpass {
         set_resizable(false);
 
         setup_controllers();
+        mark_phase("window_constructed");
     }
 
     Window::Window(std::string_view string_view) :
@@ -99,7 +81,21 @@ namespace Askpass {
 
     void Window::on_realize() {
         Base::on_realize();
+        mark_phase("window_realized");
         platform_setup(*this);
+        mark_phase("platform_setup");
+        if (is_profiling_enabled()) {
+            m_first_frame_watch = get_frame_clock()->signal_after_paint().connect(
+                sigc::mem_fun(*this, &Window::on_first_frame));
+        }
+    }
+
+    void Window::on_first_frame() {
+        m_first_frame_watch.disconnect();
+        mark_phase("first_frame");
+        if (is_cancel_after_first_frame_enabled()) {
+            on_cancle_button_clicked();
+        }
     }
 
     void Window::on_ok_button_clicked() {
@@ -136,6 +132,19 @@ namespace Askpass {
         }
     }
 
+    void Window::set_message(std::string_view label_text) {
+        m_label.set_label(Glib::ustring(label_text.data(), label_text.size()));
+    }
+
+    void Window::reset(std::string_view label_text) {
+        m_signal_succeeded.clear();
+        m_signal_failure.clear();
+        set_message(label_text);
+        m_password_entry.set_text({});
+        m_password_entry.grab_focus();
+        m_finished = false;
+    }
+
     void Window::setup_controllers() {
         add_controller([&]() {
             auto key_controller = Gtk::EventControllerKey::create();
@@ -145,4 +154,21 @@ namespace Askpass {
         }());
     }
 
+    void mark_application_phases(const Glib::RefPtr<Gtk::Application> &application) {
+        if (!is_profiling_enabled()) {
+            return;
+        }
+        mark_phase("application_created");
+        // GTK opens the display in the startup handler of the application class, after registering
+        // on the session bus
+        Gdk::DisplayManager::get()->signal_display_opened().connect(
+            [](const Glib::RefPtr<Gdk::Display> &) { mark_phase("display_opened"); });
+        application->signal_startup().connect([]() { mark_phase("startup"); });
+    }
+
+    Gio::Application::Flags application_flags() {
+        const char *non_unique = getenv(NonUniqueVariable);
+        return non_unique != nullptr && std::string_view(non_unique) == "1" ? Gio::Application::Flags::NON_UNIQUE
+                                                                           : Gio::Application::Flags::DEFAULT_FLAGS;
+    }
 } // namespace Askpass
\ No newline at end of file
@@ -0,0 +1,357 @@
+#include "broker.h"
+
+#include <algorithm>
+#include <charconv>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <gtkmm.h>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "macros.h"
+#include "model.h"
+#include "output-sink.h"
+#include "secure-buffer.h"
+#include "unique_fd.h"
+#include "unix-listener.h"
+#include "window.h"
+
+namespace {
+    constexpr char ResidentVariable[]            = "WAYLAND_SSH_ASKPASS_RESIDENT";
+    constexpr char ResidentIdleTimeoutVariable[] = "WAYLAND_SSH_ASKPASS_RESIDENT_IDLE_TIMEOUT";
+    constexpr char XdgRuntimeDirVariable[]       = "XDG_RUNTIME_DIR";
+    constexpr char SocketName[]                  = "wayland-ssh-askpass.socket";
+    constexpr char LockName[]                    = "wayland-ssh-askpass.lock";
+    constexpr unsigned int DefaultIdleTimeout    = 300;
+
+    struct BrokerConfig {
+        std::filesystem::path socket_path;
+        std::filesystem::path lock_path;
+        unsigned int idle_timeout;
+    };
+
+    std::optional<BrokerConfig> read_broker_config() {
+        const char *resident = getenv(ResidentVariable);
+        if (resident == nullptr || std::string_view(resident) != "1") {
+            return {};
+        }
+
+        const char *runtime_dir = getenv(XdgRuntimeDirVariable);
+        if (runtime_dir == nullptr || *runtime_dir == '\0') {
+            return {};
+        }
+
+        unsigned int idle_timeout = DefaultIdleTimeout;
+        if (const char *value = getenv(ResidentIdleTimeoutVariable); value != nullptr) {
+            std::string_view str = value;
+            if (auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), idle_timeout);
+                ec != std::errc {} || ptr != str.data() + str.size() || idle_timeout == 0) {
+                idle_timeout = DefaultIdleTimeout;
+            }
+        }
+
+        std::filesystem::path runtime_path = runtime_dir;
+        return BrokerConfig {runtime_path / SocketName, runtime_path / LockName, idle_timeout};
+    }
+
+    void write_all(int fd, std::span<const std::byte> data) {
+        while (!data.empty()) {
+            ssize_t result = write(fd, data.data(), data.size());
+            throw_system_error_if(result < 0 && errno != EINTR);
+            data = data.subspan(std::max<ssize_t>(result, 0));
+        }
+    }
+
+    wrapper::unique_fd connect_broker(const std::filesystem::path &path) {
+        const sockaddr_un addr = Askpass::make_unix_address(path);
+        wrapper::unique_fd s {socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+        throw_system_error_if(s.get() < 0);
+        if (connect(s.get(), reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) < 0) {
+            return {};
+        }
+        return s;
+    }
+
+    wrapper::unique_fd listen_broker(const std::filesystem::path &path) {
+        // Only called with the lock held and after connecting failed, so this is a stale socket.
+        return Askpass::listen_unix_socket(path, SOCK_STREAM);
+    }
+
+    class Broker : public sigc::trackable {
+        enum class SessionState { Receiving, Queued, Active, Replying };
+
+        struct Session {
+            wrapper::unique_fd connection;
+            SessionState state {SessionState::Receiving};
+            std::string request {};
+            std::unique_ptr<Askpass::Model> model {};
+            Askpass::OutputSink reply {};
+            sigc::scoped_connection io_watch {};
+
+            explicit Session(wrapper::unique_fd fd) : connection(std::move(fd)) {}
+        };
+
+        using session_iterator = std::list<Session>::iterator;
+
+        Glib::RefPtr<Gtk::Application> m_application;
+        BrokerConfig m_config;
+        // Taken over by m_listener once the application is activated
+        wrapper::unique_fd m_listener_fd;
+        std::optional<Askpass::UnixListener> m_listener {};
+        std::list<Session> m_sessions {};
+        Gtk::Window *m_open_window {};
+        sigc::scoped_connection m_idle_timeout {};
+
+        static std::string build_message(std::string_view request) {
+            std::vector<char *> argv {nullptr};
+            for (char *begin = const_cast<char *>(request.data()), *end = begin + request.size(); begin < end;) {
+                argv.push_back(begin);
+                begin += std::strlen(begin) + 1;
+            }
+            return Askpass::build_message(static_cast<int>(argv.size()), argv.data());
+        }
+
+        session_iterator active_session() {
+            return std::find_if(m_sessions.begin(), m_sessions.end(), [](const Session &session) {
+                return session.state == SessionState::Active;
+            });
+        }
+
+        void check_idle() {
+            if (m_sessions.empty()) {
+                m_idle_timeout = Glib::signal_timeout().connect_seconds(
+                    sigc::mem_fun(*this, &Broker::on_idle_timeout), m_config.idle_timeout);
+            }
+        }
+
+        bool on_idle_timeout() {
+            unlink(m_config.socket_path.c_str());
+            m_listener.reset();
+            m_application->release();
+            return false;
+        }
+
+        void check_spawn_window() {
+            if (m_open_window != nullptr) {
+                return;
+            }
+            auto it = std::find_if(m_sessions.begin(), m_sessions.end(), [](const Session &session) {
+                return session.state == SessionState::Queued;
+            });
+            if (it == m_sessions.end()) {
+                return;
+            }
+
+            it->state = SessionState::Active;
+            it->model = std::make_unique<Askpass::Model>(build_message(it->request), it->connection.get());
+            auto window = Gtk::make_managed<Askpass::Window>(*it->model);
+            window->signal_unrealize().connect(sigc::mem_fun(*this, &Broker::on_window_closed));
+            m_open_window = window;
+            m_application->add_window(*window);
+            window->present();
+        }
+
+        void on_window_closed() {
+            m_open_window = nullptr;
+            if (auto it = active_session(); it != m_sessions.end()) {
+                it->state = SessionState::Replying;
+                if (it->model->is_writing()) {
+                    it->model->signal_written().connect([this, it](int) { send_exit_code(it); });
+                } else {
+                    send_exit_code(it);
+                }
+            }
+            check_spawn_window();
+        }
+
+        // The exit code is the last byte of the reply, after the answer written by the model.
+        void send_exit_code(session_iterator it) {
+            const auto exit_code = static_cast<char>(it->model->exit_status());
+            it->reply.signal_done().connect([this, it](int error) {
+                if (error != 0) {
+                    std::cerr << "Failed to reply to forwarded prompt: " << std::generic_category().message(error)
+                              << '\n';
+                }
+                m_sessions.erase(it);
+                check_idle();
+            });
+            it->reply.write(it->connection.get(), {std::string_view(&exit_code, 1)});
+        }
+
+        void drop_session(session_iterator it) {
+            if (it->state == SessionState::Active && m_open_window != nullptr) {
+                // The reply is never read. on_window_closed removes the session.
+                m_open_window->close();
+            } else {
+                m_sessions.erase(it);
+                check_idle();
+            }
+        }
+
+        bool on_session_io(Glib::IOCondition condition, session_iterator it) {
+            if (it->state != SessionState::Receiving
+                || (condition & Glib::IOCondition::IO_ERR) == Glib::IOCondition::IO_ERR) {
+                it->io_watch.release();
+                drop_session(it);
+                return false;
+            }
+
+            char buffer[1024];
+            ssize_t bytes_read = read(it->connection.get(), buffer, sizeof(buffer));
+            if (bytes_read < 0 && errno == EINTR) {
+                return true;
+            } else if (bytes_read < 0) {
+                it->io_watch.release();
+                drop_session(it);
+                return false;
+            } else if (bytes_read > 0) {
+                it->request.append(buffer, bytes_read);
+                return true;
+            }
+
+            // The client shut down its writing side, the request is complete. From now on we only
+            // watch for the client going away.
+            it->io_watch.release();
+            it->state    = SessionState::Queued;
+            it->io_watch = Glib::signal_io().connect(
+                [this, it](Glib::IOCondition condition) { return on_session_io(condition, it); },
+                it->connection.get(),
+                Glib::IOCondition::IO_HUP | Glib::IOCondition::IO_ERR);
+            check_spawn_window();
+            return false;
+        }
+
+        void on_accepted(wrapper::unique_fd &connection) {
+            m_idle_timeout.disconnect();
+            auto it      = m_sessions.emplace(m_sessions.end(), std::move(connection));
+            it->io_watch = Glib::signal_io().connect(
+                [this, it](Glib::IOCondition condition) { return on_session_io(condition, it); },
+                it->connection.get(),
+                Glib::IOCondition::IO_IN | Glib::IOCondition::IO_HUP | Glib::IOCondition::IO_ERR);
+        }
+
+        void on_activate() {
+            m_application->hold();
+            // Sessions read their requests with blocking reads
+            m_listener.emplace(std::move(m_listener_fd), 0, sigc::mem_fun(*this, &Broker::on_accepted));
+            check_idle();
+        }
+
+    public:
+        Broker(std::string_view app_id, BrokerConfig config, wrapper::unique_fd listener) :
+                m_application(Gtk::Application::create(std::string(app_id), Gio::Application::Flags::NON_UNIQUE)),
+                m_config(std::move(config)), m_listener_fd(std::move(listener)) {
+            m_application->signal_activate().connect(sigc::mem_fun(*this, &Broker::on_activate));
+        }
+
+        int run() { return m_application->run(0, nullptr); }
+    };
+
+    [[noreturn]] void run_broker(std::string_view app_id, BrokerConfig config, wrapper::unique_fd listener) {
+        // Our stdio belongs to the ssh process that started us, which waits for EOF on it.
+        setsid();
+        signal(SIGPIPE, SIG_IGN);
+        if (wrapper::unique_fd null {open("/dev/null", O_RDWR | O_CLOEXEC)}; null.get() >= 0) {
+            dup2(null.get(), STDIN_FILENO);
+            dup2(null.get(), STDOUT_FILENO);
+            dup2(null.get(), STDERR_FILENO);
+        }
+
+        static constexpr const char AllowedBackends[] = "wayland,x11";
+        gdk_set_allowed_backends(AllowedBackends);
+        Broker broker {app_id, std::move(config), std::move(listener)};
+        std::exit(broker.run());
+    }
+
+    void spawn_broker(std::string_view app_id, const BrokerConfig &config, int lock_fd) {
+        wrapper::unique_fd listener = listen_broker(config.socket_path);
+        pid_t pid                   = fork();
+        throw_system_error_if(pid < 0);
+        if (pid == 0) {
+            // The startup lock must be released when our parent is done with it.
+            close(lock_fd);
+            run_broker(app_id, config, std::move(listener));
+        }
+    }
+
+    void send_request(int connection, int argc, char **argv) {
+        std::string request;
+        for (int i = 1; i < argc; ++i) {
+            request.append(argv[i]);
+            request.push_back('\0');
+        }
+        write_all(connection, std::as_bytes(std::span(request)));
+        throw_system_error_if(shutdown(connection, SHUT_WR) < 0);
+    }
+
+    std::optional<Askpass::ExitCode> receive_reply(int connection) {
+        // The answer is read straight into locked memory, plus one byte for the exit code
+        Askpass::SecureBuffer reply {Askpass::SecretCapacity + 1};
+        while (reply.size() < reply.capacity()) {
+            ssize_t bytes_read = read(connection, reply.data() + reply.size(), reply.capacity() - reply.size());
+            if (bytes_read < 0 && errno == EINTR) {
+                continue;
+            }
+            throw_system_error_if(bytes_read < 0);
+            if (bytes_read == 0) {
+                break;
+            }
+            reply.resize(reply.size() + bytes_read);
+        }
+
+        if (reply.size() == 0) {
+            // The broker went away before handling our prompt.
+            return {};
+        }
+
+        auto exit_code = static_cast<Askpass::ExitCode>(static_cast<unsigned char>(reply.view().back()));
+        reply.resize(reply.size() - 1);
+        write_all(STDOUT_FILENO, std::as_bytes(std::span(reply.view())));
+        return exit_code;
+    }
+} // namespace
+
+namespace Askpass {
+    std::optional<ExitCode> forward_to_resident_broker(std::string_view app_id, int argc, char **argv) {
+        auto config = read_broker_config();
+        if (!config) {
+            return {};
+        }
+
+        try {
+            wrapper::unique_fd connection = connect_broker(config->socket_path);
+            if (connection.get() < 0) {
+                // Serialize broker startup between concurrent invocations.
+                wrapper::unique_fd lock {open(config->lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600)};
+                throw_system_error_if(lock.get() < 0);
+                throw_system_error_if(flock(lock.get(), LOCK_EX) < 0);
+                connection = connect_broker(config->socket_path);
+                if (connection.get() < 0) {
+                    spawn_broker(app_id, *config, lock.get());
+                    connection = connect_broker(config->socket_path);
+                }
+            }
+            if (connection.get() < 0) {
+                return {};
+            }
+
+            send_request(connection.get(), argc, argv);
+            return receive_reply(connection.get());
+        } catch (const std::system_error &ex) {
+            std::cerr << "Resident broker unavailable: " << ex.what() << '\n';
+            return {};
+        }
+    }
+} // namespace Askpass
@@ -1,36 +1,26 @@
-#include <sstream>
-
 #include <gdkmm.h>
 #include <gtkmm.h>
 
+#include "broker.h"
 #include "model.h"
+#include "profiling.h"
 #include "window.h"
 
-#include <string>
-
 namespace {
     constexpr std::string_view AppId = "org.molytho.wayland-ssh-askpass";
 }; // namespace
 
-std::string build_message(int argc, char **argv) {
-    std::string str;
-
-    if (argc > 1) {
-        std::stringstream message_stream {};
-        message_stream << argv[1];
-        std::for_each(&argv[2], &argv[argc], [&](const char *str) { message_stream << ' ' << str; });
-        str = std::move(message_stream).str();
-    }
-
-    if (str.empty()) {
-        str = "No message";
+int main(int argc, char **argv) {
+    Askpass::mark_phase("main");
+    if (auto exit_code = Askpass::forward_to_resident_broker(AppId, argc, argv)) {
+        return static_cast<int>(*exit_code);
     }
 
-    return str;
-}
-
-int main(int argc, char **argv) {
-    Askpass::Model model = build_message(argc, argv);
+    Askpass::Model model = Askpass::build_message(argc, argv);
     Askpass::make_and_run_window(AppId, model);
+    // A slow reader of stdout can still hold back the answer after the window is gone
+    while (model.is_writing()) {
+        Glib::MainContext::get_default()->iteration(true);
+    }
     return static_cast<int>(model.exit_status());
 }
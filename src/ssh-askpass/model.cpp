@@ -1,30 +1,26 @@
 #include "model.h"
 
-#include <cerrno>
+#include <algorithm>
 #include <iostream>
-#include <limits>
-#include <span>
+#include <sstream>
 #include <string>
 #include <string_view>
+#include <system_error>
 
 #include <sigc++/signal.h>
 
-#include "macros.h"
-
-namespace {
-    void unbuffered_write_to_stdout(std::span<const std::byte> data) {
-        while (!data.empty()) {
-            size_t byte_to_write = std::min<std::size_t>(data.size(), std::numeric_limits<ssize_t>::max());
-            ssize_t result = write(1, data.data(), byte_to_write);
-            throw_system_error_if(result < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
-            data = data.subspan(result);
-        }
-    }
-} // namespace
-
 namespace Askpass {
     void Model::on_succeeded(std::string_view input) {
-        unbuffered_write_to_stdout(std::as_bytes(std::span<const char>(input)));
+        m_output.write(m_output_fd, {input});
+    }
+
+    void Model::on_output_done(int error) {
+        if (error != 0) {
+            std::cerr << "Failed to write the answer: " << std::generic_category().message(error) << '\n';
+            m_exit_status = ExitCode::Unknown;
+        } else {
+            m_exit_status = ExitCode::Success;
+        }
     }
 
     void Model::on_failure() {
@@ -32,5 +28,24 @@ namespace Askpass {
         m_exit_status = ExitCode::Cancelled;
     }
 
-    Model::Model(std::string message) : m_message(std::move(message)) {}
+    Model::Model(std::string message, int output_fd) : m_message(std::move(message)), m_output_fd(output_fd) {
+        m_output.signal_done().connect(sigc::mem_fun(*this, &Model::on_output_done));
+    }
+
+    std::string build_message(int argc, char **argv) {
+        std::string str;
+
+        if (argc > 1) {
+            std::stringstream message_stream {};
+            message_stream << argv[1];
+            std::for_each(&argv[2], &argv[argc], [&](const char *str) { message_stream << ' ' << str; });
+            str = std::move(message_stream).str();
+        }
+
+        if (str.empty()) {
+            str = "No message";
+        }
+
+        return str;
+    }
 } // namespace Askpass
\ No newline at end of file
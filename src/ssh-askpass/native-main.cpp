@@ -0,0 +1,41 @@
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <system_error>
+
+#include <glibmm.h>
+
+#include <unistd.h>
+
+#include "exit_codes.h"
+#include "model.h"
+#include "native-window.h"
+#include "profiling.h"
+
+namespace {
+    constexpr char GtkExecutableVariable[] = "WAYLAND_SSH_ASKPASS_GTK";
+
+    // The GTK executable gets the same arguments, it shows the prompt or forwards it to the resident broker
+    [[noreturn]] void exec_gtk_executable(char **argv) {
+        const char *variable = getenv(GtkExecutableVariable);
+        std::string path     = variable != nullptr ? variable : ASKPASS_GTK_EXECUTABLE;
+        execv(path.c_str(), argv);
+        std::cerr << "Failed to run " << path << ": " << std::system_category().message(errno) << '\n';
+        Askpass::exit(Askpass::ExitCode::InvalidPlatform);
+    }
+}; // namespace
+
+int main(int argc, char **argv) {
+    Askpass::mark_phase("main");
+    Glib::init();
+    Askpass::Model model = Askpass::build_message(argc, argv);
+    if (!Askpass::run_native_window(model)) {
+        exec_gtk_executable(argv);
+    }
+    // A slow reader of stdout can still hold back the answer after the window is gone
+    while (model.is_writing()) {
+        Glib::MainContext::get_default()->iteration(true);
+    }
+    return static_cast<int>(model.exit_status());
+}
\ No newline at end of file
@@ -0,0 +1,645 @@
+#include "native-window.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <sigc++/signal.h>
+#include <wayland-client.h>
+#include <xkbcommon/xkbcommon.h>
+
+#include <linux/input-event-codes.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "bitmap-font.h"
+#include "exit_codes.h"
+#include "macros.h"
+#include "profiling.h"
+#include "secure-buffer.h"
+#include "unique_fd.h"
+#include "wlr-layer-shell-unstable-v1-client-protocol.h"
+
+namespace {
+    constexpr char NativeVariable[] = "WAYLAND_ASKPASS_NATIVE";
+    constexpr char Namespace[]      = "askpass";
+
+    constexpr int Scale         = 2;
+    constexpr int CellWidth     = (Askpass::GlyphWidth + 1) * Scale;
+    constexpr int LineHeight    = (Askpass::GlyphHeight + 1) * Scale + 4;
+    constexpr int Width         = 480;
+    constexpr int Margin        = 16;
+    constexpr int Spacing       = 12;
+    constexpr int ControlHeight = 32;
+    constexpr int DotSize       = 8;
+
+    constexpr std::size_t MaxLines = 8;
+
+    constexpr std::uint32_t BackgroundColor    = 0xff2b2b2b;
+    constexpr std::uint32_t TextColor          = 0xffeeeeee;
+    constexpr std::uint32_t EntryColor         = 0xff1e1e1e;
+    constexpr std::uint32_t BorderColor        = 0xff5a5a5a;
+    constexpr std::uint32_t ButtonColor        = 0xff3c3c3c;
+    constexpr std::uint32_t DefaultButtonColor = 0xff2f5f9f;
+
+    template<auto Destroy>
+    struct Destroyer {
+        void operator()(auto *object) const noexcept { Destroy(object); }
+    };
+
+    template<class T, auto Destroy>
+    using Owned = std::unique_ptr<T, Destroyer<Destroy>>;
+
+    // The generated destructor sends a request which only exists since version 3
+    void destroy_layer_shell(zwlr_layer_shell_v1 *layer_shell) {
+        wl_proxy_destroy(reinterpret_cast<wl_proxy *>(layer_shell));
+    }
+
+    template<class T>
+    T *bind(wl_registry *registry, std::uint32_t name, const wl_interface &interface, std::uint32_t version) {
+        return static_cast<T *>(wl_registry_bind(registry, name, &interface, version));
+    }
+
+    struct Rect {
+        int x;
+        int y;
+        int width;
+        int height;
+
+        constexpr bool contains(int point_x, int point_y) const noexcept {
+            return point_x >= x && point_x < x + width && point_y >= y && point_y < y + height;
+        }
+    };
+
+    class Canvas {
+        std::uint32_t *m_pixels;
+        int m_width;
+        int m_height;
+
+    public:
+        Canvas(std::uint32_t *pixels, int width, int height) : m_pixels(pixels), m_width(width), m_height(height) {}
+
+        void fill(const Rect &rect, std::uint32_t color) noexcept {
+            const int x_begin = std::max(rect.x, 0);
+            const int x_end   = std::min(rect.x + rect.width, m_width);
+            const int y_begin = std::max(rect.y, 0);
+            const int y_end   = std::min(rect.y + rect.height, m_height);
+            if (x_begin >= x_end) {
+                return;
+            }
+            for (int y = y_begin; y < y_end; ++y) {
+                std::fill(&m_pixels[y * m_width + x_begin], &m_pixels[y * m_width + x_end], color);
+            }
+        }
+
+        void outline(const Rect &rect, std::uint32_t color) noexcept {
+            fill({rect.x, rect.y, rect.width, 1}, color);
+            fill({rect.x, rect.y + rect.height - 1, rect.width, 1}, color);
+            fill({rect.x, rect.y, 1, rect.height}, color);
+            fill({rect.x + rect.width - 1, rect.y, 1, rect.height}, color);
+        }
+
+        void draw_text(int x, int y, std::string_view text, std::uint32_t color) noexcept {
+            for (char character : text) {
+                const Askpass::Glyph &glyph = Askpass::get_glyph(static_cast<unsigned char>(character));
+                for (int row = 0; row < Askpass::GlyphHeight; ++row) {
+                    for (int column = 0; column < Askpass::GlyphWidth; ++column) {
+                        if (glyph[row] & (1 << (Askpass::GlyphWidth - 1 - column))) {
+                            fill({x + column * Scale, y + row * Scale, Scale, Scale}, color);
+                        }
+                    }
+                }
+                x += CellWidth;
+            }
+        }
+
+        void draw_button(const Rect &rect, std::string_view label, std::uint32_t color) noexcept {
+            fill(rect, color);
+            outline(rect, BorderColor);
+            const int text_width = static_cast<int>(label.size()) * CellWidth - Scale;
+            draw_text(rect.x + (rect.width - text_width) / 2,
+                      rect.y + (rect.height - Askpass::GlyphHeight * Scale) / 2,
+                      label,
+                      TextColor);
+        }
+    };
+
+    bool is_continuation_byte(char byte) {
+        return (static_cast<unsigned char>(byte) & 0xc0) == 0x80;
+    }
+
+    // Only ASCII has glyphs, so every other UTF-8 sequence is reduced to a single '?'
+    std::string to_drawable(std::string_view text) {
+        std::string result;
+        for (char byte : text) {
+            if (static_cast<unsigned char>(byte) < 0x80) {
+                result.push_back(byte == '\t' ? ' ' : byte);
+            } else if (!is_continuation_byte(byte)) {
+                result.push_back('?');
+            }
+        }
+        return result;
+    }
+
+    // Breaks at spaces and newlines, words longer than a line are split
+    std::vector<std::string> wrap_lines(std::string_view text, std::size_t columns) {
+        std::vector<std::string> lines(1);
+        std::size_t begin = 0;
+        while (begin <= text.size()) {
+            const std::size_t end = std::min(text.find_first_of(" \n", begin), text.size());
+            std::string_view word = text.substr(begin, end - begin);
+            while (!word.empty()) {
+                std::string &line = lines.back();
+                const std::size_t separator = line.empty() ? 0 : 1;
+                if (line.size() + separator + word.size() <= columns) {
+                    line.append(separator, ' ').append(word);
+                    break;
+                }
+                if (line.empty()) {
+                    line.append(word.substr(0, columns));
+                    word.remove_prefix(columns);
+                }
+                lines.emplace_back();
+            }
+            if (end < text.size() && text[end] == '\n') {
+                lines.emplace_back();
+            }
+            begin = end + 1;
+        }
+        while (lines.size() > 1 && lines.back().empty()) {
+            lines.pop_back();
+        }
+        lines.resize(std::min(lines.size(), MaxLines));
+        return lines;
+    }
+
+    std::size_t count_characters(std::string_view text) {
+        return std::ranges::count_if(text, [](char byte) { return !is_continuation_byte(byte); });
+    }
+} // namespace
+
+namespace Askpass {
+    struct NativeConnection {
+        struct ShmBuffer {
+            Owned<wl_buffer, wl_buffer_destroy> buffer;
+            std::uint32_t *pixels = nullptr;
+            bool busy             = false;
+        };
+
+        Owned<wl_display, wl_display_disconnect> display;
+        Owned<wl_registry, wl_registry_destroy> registry;
+        Owned<wl_compositor, wl_compositor_destroy> compositor;
+        Owned<wl_shm, wl_shm_destroy> shm;
+        Owned<wl_seat, wl_seat_destroy> seat;
+        Owned<zwlr_layer_shell_v1, destroy_layer_shell> layer_shell;
+        Owned<wl_surface, wl_surface_destroy> surface;
+        Owned<zwlr_layer_surface_v1, zwlr_layer_surface_v1_destroy> layer_surface;
+        Owned<wl_callback, wl_callback_destroy> frame_callback;
+        Owned<wl_keyboard, wl_keyboard_destroy> keyboard;
+        Owned<wl_pointer, wl_pointer_destroy> pointer;
+        Owned<xkb_context, xkb_context_unref> keymap_context;
+        Owned<xkb_keymap, xkb_keymap_unref> keymap;
+        Owned<xkb_state, xkb_state_unref> key_state;
+
+        void *pool_data       = MAP_FAILED;
+        std::size_t pool_size = 0;
+        std::array<ShmBuffer, 2> buffers;
+
+        sigc::signal<on_succeeded_func_t> succeeded;
+        sigc::signal<on_failure_func_t> failure;
+
+        SecureBuffer secret;
+        std::vector<std::string> lines;
+        Rect entry;
+        Rect cancel_button;
+        Rect ok_button;
+        int height;
+        int pointer_x = 0;
+        int pointer_y = 0;
+
+        bool configured          = false;
+        bool redraw_pending      = false;
+        bool first_frame_watched = false;
+        bool finished            = false;
+
+        explicit NativeConnection(std::string_view message);
+
+        ~NativeConnection();
+
+        // Returns false if a required global is missing or the buffers can't be allocated
+        bool connect();
+
+        void create_buffers();
+        void redraw();
+        void draw(Canvas &canvas) const;
+
+        void accept();
+        void cancel();
+        void erase_last_character();
+
+        void on_global(std::uint32_t name, std::string_view interface, std::uint32_t version);
+        void on_seat_capabilities(std::uint32_t capabilities);
+        void on_configure(std::uint32_t serial);
+        void on_buffer_release(wl_buffer *buffer);
+        void on_first_frame();
+        void on_keymap(std::uint32_t format, int fd, std::uint32_t size);
+        void on_key(std::uint32_t key, std::uint32_t state);
+        void on_modifiers(std::uint32_t depressed, std::uint32_t latched, std::uint32_t locked, std::uint32_t group);
+        void on_button(std::uint32_t button, std::uint32_t state);
+    };
+} // namespace Askpass
+
+namespace {
+    using Askpass::NativeConnection;
+
+    NativeConnection &get_connection(void *data) {
+        return *static_cast<NativeConnection *>(data);
+    }
+
+    constexpr wl_registry_listener RegistryListener {
+        .global = [](void *data, wl_registry *, std::uint32_t name, const char *interface, std::uint32_t version) {
+            get_connection(data).on_global(name, interface, version);
+        },
+        .global_remove = [](void *, wl_registry *, std::uint32_t) {},
+    };
+
+    constexpr wl_seat_listener SeatListener {
+        .capabilities = [](void *data, wl_seat *, std::uint32_t capabilities) {
+            get_connection(data).on_seat_capabilities(capabilities);
+        },
+        .name = [](void *, wl_seat *, const char *) {},
+    };
+
+    constexpr zwlr_layer_surface_v1_listener LayerSurfaceListener {
+        .configure = [](void *data, zwlr_layer_surface_v1 *, std::uint32_t serial, std::uint32_t, std::uint32_t) {
+            get_connection(data).on_configure(serial);
+        },
+        .closed = [](void *data, zwlr_layer_surface_v1 *) { get_connection(data).cancel(); },
+    };
+
+    constexpr wl_buffer_listener BufferListener {
+        .release = [](void *data, wl_buffer *buffer) { get_connection(data).on_buffer_release(buffer); },
+    };
+
+    constexpr wl_callback_listener FrameListener {
+        .done = [](void *data, wl_callback *, std::uint32_t) { get_connection(data).on_first_frame(); },
+    };
+
+    constexpr wl_keyboard_listener KeyboardListener {
+        .keymap = [](void *data, wl_keyboard *, std::uint32_t format, std::int32_t fd, std::uint32_t size) {
+            get_connection(data).on_keymap(format, fd, size);
+        },
+        .enter = [](void *, wl_keyboard *, std::uint32_t, wl_surface *, wl_array *) {},
+        .leave = [](void *, wl_keyboard *, std::uint32_t, wl_surface *) {},
+        .key = [](void *data, wl_keyboard *, std::uint32_t, std::uint32_t, std::uint32_t key, std::uint32_t state) {
+            get_connection(data).on_key(key, state);
+        },
+        .modifiers = [](void *data, wl_keyboard *, std::uint32_t, std::uint32_t depressed, std::uint32_t latched,
+                        std::uint32_t locked, std::uint32_t group) {
+            get_connection(data).on_modifiers(depressed, latched, locked, group);
+        },
+        .repeat_info = [](void *, wl_keyboard *, std::int32_t, std::int32_t) {},
+    };
+
+    // Bound with version 4 at most, so no event after axis is sent. The later members differ
+    // between libwayland releases and stay null.
+    constexpr wl_pointer_listener PointerListener = [] {
+        wl_pointer_listener listener {};
+        listener.enter = [](void *data, wl_pointer *, std::uint32_t, wl_surface *, wl_fixed_t x, wl_fixed_t y) {
+            get_connection(data).pointer_x = wl_fixed_to_int(x);
+            get_connection(data).pointer_y = wl_fixed_to_int(y);
+        };
+        listener.leave  = [](void *, wl_pointer *, std::uint32_t, wl_surface *) {};
+        listener.motion = [](void *data, wl_pointer *, std::uint32_t, wl_fixed_t x, wl_fixed_t y) {
+            get_connection(data).pointer_x = wl_fixed_to_int(x);
+            get_connection(data).pointer_y = wl_fixed_to_int(y);
+        };
+        listener.button = [](void *data, wl_pointer *, std::uint32_t, std::uint32_t, std::uint32_t button, std::uint32_t state) {
+            get_connection(data).on_button(button, state);
+        };
+        listener.axis = [](void *, wl_pointer *, std::uint32_t, std::uint32_t, wl_fixed_t) {};
+        return listener;
+    }();
+} // namespace
+
+namespace Askpass {
+    NativeConnection::NativeConnection(std::string_view message) :
+            lines(wrap_lines(to_drawable(message), (Width - 2 * Margin) / CellWidth)) {
+        const int entry_y      = Margin + static_cast<int>(lines.size()) * LineHeight + Spacing;
+        const int button_y     = entry_y + ControlHeight + Spacing;
+        const int button_width = (Width - 2 * Margin - Spacing) / 2;
+        entry                  = {Margin, entry_y, Width - 2 * Margin, ControlHeight};
+        cancel_button          = {Margin, button_y, button_width, ControlHeight};
+        ok_button              = {Width - Margin - button_width, button_y, button_width, ControlHeight};
+        height                 = button_y + ControlHeight + Margin;
+    }
+
+    NativeConnection::~NativeConnection() {
+        if (pool_data != MAP_FAILED) {
+            munmap(pool_data, pool_size);
+        }
+    }
+
+    bool NativeConnection::connect() {
+        display.reset(wl_display_connect(nullptr));
+        if (!display) {
+            return false;
+        }
+        registry.reset(wl_display_get_registry(display.get()));
+        wl_registry_add_listener(registry.get(), &RegistryListener, this);
+        // The first roundtrip announces the globals, the second one the seat capabilities
+        if (wl_display_roundtrip(display.get()) == -1 || wl_display_roundtrip(display.get()) == -1) {
+            return false;
+        }
+        if (!compositor || !shm || !seat || !layer_shell) {
+            return false;
+        }
+        keymap_context.reset(xkb_context_new(XKB_CONTEXT_NO_FLAGS));
+        if (!keymap_context) {
+            return false;
+        }
+        mark_phase("native_connected");
+
+        // Without shared memory GTK may still be able to show the prompt
+        try {
+            create_buffers();
+        } catch (const std::system_error &ex) {
+            std::cerr << "Failed to create the window buffers: " << ex.what() << '\n';
+            return false;
+        }
+        surface.reset(wl_compositor_create_surface(compositor.get()));
+        layer_surface.reset(zwlr_layer_shell_v1_get_layer_surface(
+            layer_shell.get(), surface.get(), nullptr, ZWLR_LAYER_SHELL_V1_LAYER_OVERLAY, Namespace));
+        zwlr_layer_surface_v1_add_listener(layer_surface.get(), &LayerSurfaceListener, this);
+        zwlr_layer_surface_v1_set_size(layer_surface.get(), Width, height);
+        // Without anchors the surface is centered on the output
+        zwlr_layer_surface_v1_set_keyboard_interactivity(
+            layer_surface.get(), ZWLR_LAYER_SURFACE_V1_KEYBOARD_INTERACTIVITY_EXCLUSIVE);
+        wl_surface_commit(surface.get());
+        return true;
+    }
+
+    void NativeConnection::create_buffers() {
+        const int stride      = Width * static_cast<int>(sizeof(std::uint32_t));
+        const int buffer_size = stride * height;
+        pool_size             = static_cast<std::size_t>(buffer_size) * buffers.size();
+
+        wrapper::unique_fd fd {memfd_create(Namespace, MFD_CLOEXEC)};
+        throw_system_error_if(fd.get() == -1);
+        throw_system_error_if(ftruncate(fd.get(), static_cast<off_t>(pool_size)) == -1);
+        pool_data = mmap(nullptr, pool_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+        throw_system_error_if(pool_data == MAP_FAILED);
+
+        Owned<wl_shm_pool, wl_shm_pool_destroy> pool {
+            wl_shm_create_pool(shm.get(), fd.get(), static_cast<std::int32_t>(pool_size))};
+        for (std::size_t i = 0; i < buffers.size(); ++i) {
+            const int offset = static_cast<int>(i) * buffer_size;
+            buffers[i].buffer.reset(
+                wl_shm_pool_create_buffer(pool.get(), offset, Width, height, stride, WL_SHM_FORMAT_ARGB8888));
+            buffers[i].pixels = reinterpret_cast<std::uint32_t *>(static_cast<char *>(pool_data) + offset);
+            wl_buffer_add_listener(buffers[i].buffer.get(), &BufferListener, this);
+        }
+    }
+
+    void NativeConnection::redraw() {
+        if (!configured || finished) {
+            return;
+        }
+        auto buffer = std::ranges::find_if(buffers, [](const ShmBuffer &buffer) { return !buffer.busy; });
+        if (buffer == buffers.end()) {
+            // Drawn as soon as the compositor releases a buffer
+            redraw_pending = true;
+            return;
+        }
+        redraw_pending = false;
+
+        Canvas canvas {buffer->pixels, Width, height};
+        draw(canvas);
+        wl_surface_attach(surface.get(), buffer->buffer.get(), 0, 0);
+        wl_surface_damage(surface.get(), 0, 0, Width, height);
+        if (!first_frame_watched) {
+            first_frame_watched = true;
+            frame_callback.reset(wl_surface_frame(surface.get()));
+            wl_callback_add_listener(frame_callback.get(), &FrameListener, this);
+        }
+        wl_surface_commit(surface.get());
+        buffer->busy = true;
+    }
+
+    void NativeConnection::draw(Canvas &canvas) const {
+        canvas.fill({0, 0, Width, height}, BackgroundColor);
+        for (std::size_t i = 0; i < lines.size(); ++i) {
+            canvas.draw_text(Margin, Margin + static_cast<int>(i) * LineHeight, lines[i], TextColor);
+        }
+
+        canvas.fill(entry, EntryColor);
+        canvas.outline(entry, BorderColor);
+        // One dot per character, as many as fit
+        const int dot_y   = entry.y + (entry.height - DotSize) / 2;
+        const int dot_end = entry.x + entry.width - Spacing;
+        int x             = entry.x + Spacing;
+        for (std::size_t i = count_characters(secret.view()); i > 0 && x + DotSize <= dot_end; --i) {
+            canvas.fill({x, dot_y, DotSize, DotSize}, TextColor);
+            x += DotSize + DotSize / 2;
+        }
+        canvas.fill({x, entry.y + Spacing / 2, Scale, entry.height - Spacing}, TextColor);
+
+        canvas.draw_button(cancel_button, "Cancel", ButtonColor);
+        canvas.draw_button(ok_button, "Ok", DefaultButtonColor);
+    }
+
+    void NativeConnection::accept() {
+        if (finished) {
+            return;
+        }
+        finished = true;
+        succeeded.emit(secret.view());
+        secret.clear();
+    }
+
+    void NativeConnection::cancel() {
+        if (finished) {
+            return;
+        }
+        finished = true;
+        secret.clear();
+        failure.emit();
+    }
+
+    void NativeConnection::erase_last_character() {
+        std::size_t size = secret.size();
+        // Back to the first byte of the last UTF-8 sequence
+        while (size > 0 && is_continuation_byte(secret.data()[--size])) {}
+        secret.erase(size, secret.size() - size);
+    }
+
+    void NativeConnection::on_global(std::uint32_t name, std::string_view interface, std::uint32_t version) {
+        if (interface == wl_compositor_interface.name) {
+            compositor.reset(bind<wl_compositor>(registry.get(), name, wl_compositor_interface, 1));
+        } else if (interface == wl_shm_interface.name) {
+            shm.reset(bind<wl_shm>(registry.get(), name, wl_shm_interface, 1));
+        } else if (interface == wl_seat_interface.name && !seat) {
+            seat.reset(bind<wl_seat>(registry.get(), name, wl_seat_interface, std::min(version, 4u)));
+            wl_seat_add_listener(seat.get(), &SeatListener, this);
+        } else if (interface == zwlr_layer_shell_v1_interface.name) {
+            layer_shell.reset(
+                bind<zwlr_layer_shell_v1>(registry.get(), name, zwlr_layer_shell_v1_interface, std::min(version, 4u)));
+        }
+    }
+
+    void NativeConnection::on_seat_capabilities(std::uint32_t capabilities) {
+        if ((capabilities & WL_SEAT_CAPABILITY_KEYBOARD) && !keyboard) {
+            keyboard.reset(wl_seat_get_keyboard(seat.get()));
+            wl_keyboard_add_listener(keyboard.get(), &KeyboardListener, this);
+        }
+        if ((capabilities & WL_SEAT_CAPABILITY_POINTER) && !pointer) {
+            pointer.reset(wl_seat_get_pointer(seat.get()));
+            wl_pointer_add_listener(pointer.get(), &PointerListener, this);
+        }
+    }
+
+    void NativeConnection::on_configure(std::uint32_t serial) {
+        zwlr_layer_surface_v1_ack_configure(layer_surface.get(), serial);
+        configured = true;
+        redraw();
+    }
+
+    void NativeConnection::on_buffer_release(wl_buffer *released) {
+        for (auto &buffer : buffers) {
+            if (buffer.buffer.get() == released) {
+                buffer.busy = false;
+            }
+        }
+        if (redraw_pending) {
+            redraw();
+        }
+    }
+
+    void NativeConnection::on_first_frame() {
+        frame_callback.reset();
+        mark_phase("first_frame");
+        if (is_cancel_after_first_frame_enabled()) {
+            cancel();
+        }
+    }
+
+    void NativeConnection::on_keymap(std::uint32_t format, int fd, std::uint32_t size) {
+        wrapper::unique_fd keymap_fd {fd};
+        if (format != WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1) {
+            return;
+        }
+        void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, keymap_fd.get(), 0);
+        if (data == MAP_FAILED) {
+            return;
+        }
+        const char *text = static_cast<const char *>(data);
+        key_state.reset();
+        keymap.reset(xkb_keymap_new_from_buffer(keymap_context.get(),
+                                                text,
+                                                strnlen(text, size),
+                                                XKB_KEYMAP_FORMAT_TEXT_V1,
+                                                XKB_KEYMAP_COMPILE_NO_FLAGS));
+        munmap(data, size);
+        if (keymap) {
+            key_state.reset(xkb_state_new(keymap.get()));
+        }
+    }
+
+    void NativeConnection::on_key(std::uint32_t key, std::uint32_t state) {
+        if (state != WL_KEYBOARD_KEY_STATE_PRESSED || !key_state) {
+            return;
+        }
+        // Wayland sends evdev codes, xkb codes are offset by 8
+        const xkb_keycode_t keycode = key + 8;
+        switch (xkb_state_key_get_one_sym(key_state.get(), keycode)) {
+        case XKB_KEY_Return:
+        case XKB_KEY_KP_Enter:
+            return accept();
+        case XKB_KEY_Escape:
+            return cancel();
+        case XKB_KEY_BackSpace:
+            erase_last_character();
+            return redraw();
+        default:
+            break;
+        }
+
+        char text[16];
+        const int length = xkb_state_key_get_utf8(key_state.get(), keycode, text, sizeof(text));
+        if (length == 1 && text[0] == '\x03') {
+            cancel();
+        } else if (length == 1 && text[0] == '\x15') {
+            secret.clear();
+            redraw();
+        } else if (length > 0 && static_cast<std::size_t>(length) < sizeof(text)
+                   && static_cast<unsigned char>(text[0]) >= ' ' && text[0] != '\x7f') {
+            if (secret.insert(secret.size(), {text, static_cast<std::size_t>(length)})) {
+                redraw();
+            }
+        }
+        explicit_bzero(text, sizeof(text));
+    }
+
+    void NativeConnection::on_modifiers(std::uint32_t depressed,
+                                        std::uint32_t latched,
+                                        std::uint32_t locked,
+                                        std::uint32_t group) {
+        if (key_state) {
+            xkb_state_update_mask(key_state.get(), depressed, latched, locked, 0, 0, group);
+        }
+    }
+
+    void NativeConnection::on_button(std::uint32_t button, std::uint32_t state) {
+        if (button != BTN_LEFT || state != WL_POINTER_BUTTON_STATE_PRESSED) {
+            return;
+        }
+        if (cancel_button.contains(pointer_x, pointer_y)) {
+            cancel();
+        } else if (ok_button.contains(pointer_x, pointer_y)) {
+            accept();
+        }
+    }
+
+    NativeWindow::NativeWindow(std::unique_ptr<NativeConnection> connection) : m_connection(std::move(connection)) {}
+
+    NativeWindow::~NativeWindow() = default;
+
+    std::unique_ptr<NativeWindow> NativeWindow::connect(std::string_view message) {
+        const char *native = getenv(NativeVariable);
+        if (native != nullptr && std::string_view(native) == "0") {
+            return nullptr;
+        }
+        auto connection = std::make_unique<NativeConnection>(message);
+        if (!connection->connect()) {
+            return nullptr;
+        }
+        return std::unique_ptr<NativeWindow>(new NativeWindow(std::move(connection)));
+    }
+
+    sigc::signal<on_succeeded_func_t> NativeWindow::signal_succeeded() {
+        return m_connection->succeeded;
+    }
+
+    sigc::signal<on_failure_func_t> NativeWindow::signal_failure() {
+        return m_connection->failure;
+    }
+
+    void NativeWindow::run() {
+        while (!m_connection->finished) {
+            if (wl_display_dispatch(m_connection->display.get()) == -1) {
+                std::cerr << "Lost the connection to the compositor: " << std::system_category().message(errno)
+                          << '\n';
+                exit(ExitCode::Unknown);
+            }
+        }
+    }
+} // namespace Askpass
\ No newline at end of file
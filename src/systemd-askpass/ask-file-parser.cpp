@@ -0,0 +1,180 @@
+#include "ask-file-parser.h"
+
+#include <array>
+#include <charconv>
+
+namespace {
+    enum Keys { KEY_MESSAGE, KEY_ID, KEY_ICON, KEY_SOCKET, KEY_PID, KEY_NOT_AFTER, KEY_ECHO, KEY_ACCEPT_CACHED, KEY_MAX };
+
+    constexpr std::array<std::string_view, KEY_MAX> KeyNames {
+        "Message", "Id", "Icon", "Socket", "PID", "NotAfter", "Echo", "AcceptCached"};
+
+    constexpr std::string_view AskSection = "Ask";
+    constexpr std::string_view Whitespace = " \t\r";
+
+    std::string_view trim(std::string_view str) {
+        auto begin = str.find_first_not_of(Whitespace);
+        if (begin == std::string_view::npos) {
+            return {};
+        }
+        auto end = str.find_last_not_of(Whitespace);
+        return str.substr(begin, end - begin + 1);
+    }
+
+    class Parser {
+        std::string_view m_buffer;
+        std::size_t m_line {0};
+        bool m_in_ask_section {false};
+        unsigned int m_seen_keys {0};
+        Askpass::AskFile m_result {};
+
+        [[noreturn]] void fail(std::string_view message) const {
+            throw Askpass::AskFileParseError(m_line, std::string(message));
+        }
+
+        [[noreturn]] void fail_value(Keys key, std::string_view expected) const {
+            std::string message = "invalid value for '";
+            message.append(KeyNames[key]).append("': expected ").append(expected);
+            fail(message);
+        }
+
+        template<class T>
+        T parse_integer(Keys key, std::string_view value) const {
+            T result {};
+            auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+            if (value.empty() || ec != std::errc {} || ptr != value.data() + value.size() || result < 0) {
+                fail_value(key, "a non-negative integer");
+            }
+            return result;
+        }
+
+        bool parse_bool(Keys key, std::string_view value) const {
+            if (value == "1" || value == "yes" || value == "true" || value == "on") {
+                return true;
+            } else if (value == "0" || value == "no" || value == "false" || value == "off") {
+                return false;
+            }
+            fail_value(key, "a boolean");
+        }
+
+        void parse_section(std::string_view line) {
+            if (line.back() != ']') {
+                fail("unterminated section header");
+            }
+            m_in_ask_section = trim(line.substr(1, line.size() - 2)) == AskSection;
+        }
+
+        void parse_assignment(std::string_view line) {
+            auto separator = line.find('=');
+            if (separator == std::string_view::npos) {
+                fail("expected 'key=value'");
+            }
+            std::string_view key   = trim(line.substr(0, separator));
+            std::string_view value = trim(line.substr(separator + 1));
+            if (key.empty()) {
+                fail("empty key");
+            }
+            if (!m_in_ask_section) {
+                return;
+            }
+
+            std::size_t index = 0;
+            while (index < KEY_MAX && KeyNames[index] != key) {
+                ++index;
+            }
+            if (index == KEY_MAX) {
+                return;
+            }
+            if (m_seen_keys & (1u << index)) {
+                std::string message = "duplicate key '";
+                message.append(key).append("'");
+                fail(message);
+            }
+            m_seen_keys |= 1u << index;
+
+            switch (static_cast<Keys>(index)) {
+            case KEY_MESSAGE:
+                m_result.message = value;
+                break;
+            case KEY_ID:
+                m_result.id = value;
+                break;
+            case KEY_ICON:
+                m_result.icon = value;
+                break;
+            case KEY_SOCKET:
+                if (value.empty()) {
+                    fail_value(KEY_SOCKET, "a socket path");
+                }
+                m_result.socket = value;
+                break;
+            case KEY_PID:
+                m_result.pid = parse_integer<int>(KEY_PID, value);
+                if (m_result.pid == 0) {
+                    fail_value(KEY_PID, "a process id");
+                }
+                break;
+            case KEY_NOT_AFTER:
+                m_result.not_after = parse_integer<time_t>(KEY_NOT_AFTER, value);
+                break;
+            case KEY_ECHO:
+                m_result.echo = parse_bool(KEY_ECHO, value);
+                break;
+            case KEY_ACCEPT_CACHED:
+                m_result.accept_cached = parse_bool(KEY_ACCEPT_CACHED, value);
+                break;
+            case KEY_MAX:
+                break;
+            }
+        }
+
+        void require(Keys key) {
+            if (!(m_seen_keys & (1u << key))) {
+                std::string message = "missing required key '";
+                message.append(KeyNames[key]).append("' in [Ask]");
+                fail(message);
+            }
+        }
+
+    public:
+        explicit Parser(std::string_view buffer) : m_buffer(buffer) {}
+
+        Askpass::AskFile parse(bool require_endpoint) {
+            while (!m_buffer.empty()) {
+                ++m_line;
+                auto end              = m_buffer.find('\n');
+                std::string_view line = trim(m_buffer.substr(0, end));
+                m_buffer.remove_prefix(end == std::string_view::npos ? m_buffer.size() : end + 1);
+
+                if (line.empty() || line.front() == '#' || line.front() == ';') {
+                    continue;
+                } else if (line.front() == '[') {
+                    parse_section(line);
+                } else {
+                    parse_assignment(line);
+                }
+            }
+
+            m_line = 0;
+            if (require_endpoint) {
+                require(KEY_PID);
+                require(KEY_SOCKET);
+            }
+            return m_result;
+        }
+    };
+} // namespace
+
+namespace Askpass {
+    AskFileParseError::AskFileParseError(std::size_t line, const std::string &message) :
+            std::runtime_error(line == 0 ? message : "line " + std::to_string(line) + ": " + message),
+            m_line(line) {}
+
+    AskFile parse_ask_file(std::string_view buffer) {
+        return Parser(buffer).parse(true);
+    }
+
+    AskFile parse_ask_request(std::string_view buffer) {
+        return Parser(buffer).parse(false);
+    }
+} // namespace Askpass
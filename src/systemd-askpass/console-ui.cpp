@@ -0,0 +1,160 @@
+#include "console-ui.h"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "process-watch.h"
+
+namespace {
+    constexpr char KeyCtrlC     = 0x03;
+    constexpr char KeyBackspace = 0x08;
+    constexpr char KeyCtrlU     = 0x15;
+    constexpr char KeyEscape    = 0x1b;
+    constexpr char KeyDelete    = 0x7f;
+
+    // Moves to the start of the line and clears it
+    constexpr std::string_view ClearLine = "\r\033[K";
+
+    // Drops the last UTF-8 character
+    void erase_last_character(Askpass::SecureBuffer &buffer) {
+        std::size_t size = buffer.size();
+        while (size > 0 && (static_cast<unsigned char>(buffer.data()[size - 1]) & 0xc0) == 0x80) {
+            --size;
+        }
+        buffer.resize(size > 0 ? size - 1 : 0);
+    }
+} // namespace
+
+namespace Askpass {
+    ConsoleUi::ConsoleUi() :
+            m_main_loop(Glib::MainLoop::create()),
+            m_tty_fd(open("/dev/tty", O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC)) {}
+
+    ConsoleUi::~ConsoleUi() {
+        if (m_saved_attributes) {
+            tcsetattr(m_tty_fd.get(), TCSAFLUSH, &*m_saved_attributes);
+        }
+    }
+
+    void ConsoleUi::print(std::string_view text) {
+        // The terminal is non-blocking, a prompt is small enough to never be cut short in practice
+        while (!text.empty()) {
+            ssize_t result = write(m_tty_fd.get(), text.data(), text.size());
+            if (result < 0 && errno == EINTR) {
+                continue;
+            } else if (result <= 0) {
+                return;
+            }
+            text.remove_prefix(static_cast<std::size_t>(result));
+        }
+    }
+
+    void ConsoleUi::print_prompt(std::string_view message) {
+        print(ClearLine);
+        print(message);
+        print(": ");
+    }
+
+    void ConsoleUi::spawn_window(WindowModel &model) {
+        termios attributes {};
+        if (tcgetattr(m_tty_fd.get(), &attributes) == 0) {
+            m_saved_attributes = attributes;
+            // Byte by byte without echo, and Ctrl-C arrives as input instead of a signal
+            attributes.c_lflag &= ~(ECHO | ICANON | ISIG);
+            attributes.c_cc[VMIN]  = 1;
+            attributes.c_cc[VTIME] = 0;
+            tcsetattr(m_tty_fd.get(), TCSAFLUSH, &attributes);
+        }
+
+        m_window.emplace();
+        m_input.clear();
+        model.register_window(*m_window);
+        print("\n");
+        print_prompt(model.message());
+        m_input_watch = Glib::signal_io().connect(sigc::mem_fun(*this, &ConsoleUi::on_input), m_tty_fd.get(),
+            Glib::IOCondition::IO_IN | Glib::IOCondition::IO_HUP | Glib::IOCondition::IO_ERR);
+    }
+
+    void ConsoleUi::update_window(WindowModel &model) {
+        print_prompt(model.message());
+    }
+
+    void ConsoleUi::close_window() {
+        if (!m_window || m_closing) {
+            return;
+        }
+        m_closing = true;
+        m_input_watch.disconnect();
+        m_input.clear();
+        if (m_saved_attributes) {
+            tcsetattr(m_tty_fd.get(), TCSAFLUSH, &*m_saved_attributes);
+            m_saved_attributes.reset();
+        }
+        print("\n");
+        // Like the GTK window, closing is reported from the main loop
+        Glib::signal_idle().connect_once(sigc::mem_fun(*this, &ConsoleUi::emit_signal_window_closed));
+    }
+
+    void ConsoleUi::emit_signal_window_closed() {
+        m_window.reset();
+        m_closing = false;
+        m_window_closed_signal.emit();
+    }
+
+    bool ConsoleUi::on_input(Glib::IOCondition condition) {
+        char buffer[64];
+        ssize_t result = read(m_tty_fd.get(), buffer, sizeof(buffer));
+        if (result < 0 && (errno == EINTR || errno == EAGAIN)) {
+            return true;
+        } else if (result <= 0 || (condition & Glib::IOCondition::IO_ERR) == Glib::IOCondition::IO_ERR) {
+            // The terminal went away
+            m_input_watch.release();
+            m_window->signal_failure().emit();
+            close_window();
+            return false;
+        }
+        for (ssize_t i = 0; i < result && m_input_watch.connected(); ++i) {
+            on_key(buffer[i]);
+        }
+        explicit_bzero(buffer, sizeof(buffer));
+        return m_input_watch.connected();
+    }
+
+    void ConsoleUi::on_key(char key) {
+        switch (key) {
+        case '\r':
+        case '\n':
+            m_input_watch.release();
+            m_window->signal_succeeded().emit(m_input.view());
+            close_window();
+            break;
+        case KeyCtrlC:
+        case KeyEscape:
+            m_input_watch.release();
+            m_window->signal_failure().emit();
+            close_window();
+            break;
+        case KeyBackspace:
+        case KeyDelete:
+            erase_last_character(m_input);
+            break;
+        case KeyCtrlU:
+            m_input.clear();
+            break;
+        default:
+            m_input.insert(m_input.size(), std::string_view(&key, 1));
+            break;
+        }
+    }
+
+    sigc::connection ConsoleUi::watch_process(int pid, const sigc::slot<void()> &func) {
+        return Askpass::watch_process(pid, func);
+    }
+
+    int ConsoleUi::run(int, char *[]) {
+        m_main_loop->run();
+        return 0;
+    }
+} // namespace Askpass
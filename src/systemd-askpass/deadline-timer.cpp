@@ -0,0 +1,43 @@
+#include "deadline-timer.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "macros.h"
+
+namespace Askpass {
+    DeadlineTimer::DeadlineTimer() : m_timer_fd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {
+        throw_system_error_if(m_timer_fd.get() < 0);
+        m_io_watch = Glib::signal_io().connect(
+            sigc::mem_fun(*this, &DeadlineTimer::on_expired), m_timer_fd.get(), Glib::IOCondition::IO_IN);
+    }
+
+    sigc::connection DeadlineTimer::arm(time_t deadline, const sigc::slot<void()> &func) {
+        // A zero it_value would disarm the timer, deadlines that already passed fire right away
+        deadline = std::max<time_t>(deadline, 1);
+        itimerspec spec {};
+        spec.it_value.tv_sec  = deadline / 1000000;
+        spec.it_value.tv_nsec = deadline % 1000000 * 1000;
+        throw_system_error_if(timerfd_settime(m_timer_fd.get(), TFD_TIMER_ABSTIME, &spec, nullptr) < 0);
+        m_func = func;
+        return sigc::connection(m_func);
+    }
+
+    bool DeadlineTimer::on_expired(Glib::IOCondition) {
+        std::uint64_t expirations;
+        if (read(m_timer_fd.get(), &expirations, sizeof(expirations)) < 0) {
+            // Re-armed after it became readable
+            return true;
+        }
+        // func may arm the timer again
+        auto func = std::move(m_func);
+        m_func    = {};
+        if (!func.empty()) {
+            func();
+        }
+        return true;
+    }
+} // namespace Askpass
@@ -0,0 +1,55 @@
+#include "keyring.h"
+
+#include <cerrno>
+#include <iostream>
+#include <string>
+#include <system_error>
+
+#include <linux/keyctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+    // Keys of type "user" hold arbitrary data. systemd caches answers the same way, as the answer's
+    // passwords separated by NUL bytes.
+    constexpr char KeyType[] = "user";
+
+    long request_key(const std::string &description) {
+        return syscall(SYS_request_key, KeyType, description.c_str(), nullptr, KEY_SPEC_USER_KEYRING);
+    }
+
+    long add_key(const std::string &description, std::string_view payload) {
+        return syscall(SYS_add_key, KeyType, description.c_str(), payload.data(), payload.size(),
+            KEY_SPEC_USER_KEYRING);
+    }
+
+    template<class... Args>
+    long keyctl(int operation, Args... args) {
+        return syscall(SYS_keyctl, operation, args...);
+    }
+} // namespace
+
+namespace Askpass {
+    bool lookup_cached_answer(std::string_view id, SecureBuffer &answer) {
+        long serial = request_key(std::string(id));
+        if (serial < 0) {
+            return false;
+        }
+        long size = keyctl(KEYCTL_READ, serial, answer.data(), answer.capacity());
+        if (size < 0 || static_cast<std::size_t>(size) > answer.capacity()) {
+            // A truncated read still left part of the key behind
+            answer.resize(answer.capacity());
+            answer.clear();
+            return false;
+        }
+        answer.resize(static_cast<std::size_t>(size));
+        return true;
+    }
+
+    void store_cached_answer(std::string_view id, std::string_view answer, unsigned int timeout) {
+        long serial = add_key(std::string(id), answer);
+        if (serial < 0 || keyctl(KEYCTL_SET_TIMEOUT, serial, timeout) < 0) {
+            std::cerr << "Failed to cache answer: " << std::generic_category().message(errno) << '\n';
+        }
+    }
+} // namespace Askpass
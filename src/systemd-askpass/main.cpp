@@ -1,51 +1,316 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <system_error>
+#include <vector>
 
 #include <glib-unix.h>
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "console-ui.h"
+#include "deadline-timer.h"
+#include "macros.h"
+#include "metrics-endpoint.h"
 #include "model.h"
+#include "process-watch.h"
+#include "profiling.h"
+#include "request-socket.h"
+#include "tracing.h"
 #include "window-model.h"
 #include "window.h"
 
 namespace {
-    constexpr std::string_view AppId       = "org.molytho.wayland-systemd-askpass";
-    constexpr char XdgRuntimeDirVariable[] = "XDG_RUNTIME_DIR";
+    constexpr std::string_view AppId        = "org.molytho.wayland-systemd-askpass";
+    constexpr char XdgRuntimeDirVariable[]  = "XDG_RUNTIME_DIR";
+    constexpr char WaylandDisplayVariable[] = "WAYLAND_DISPLAY";
+    constexpr char X11DisplayVariable[]     = "DISPLAY";
+    constexpr char QueuePolicyVariable[]    = "WAYLAND_SYSTEMD_ASKPASS_QUEUE_POLICY";
+    constexpr char BatchVariable[]          = "WAYLAND_SYSTEMD_ASKPASS_BATCH";
+    constexpr char IdleExitVariable[]       = "WAYLAND_SYSTEMD_ASKPASS_IDLE_EXIT";
+    constexpr char CacheTimeoutVariable[]   = "WAYLAND_SYSTEMD_ASKPASS_CACHE_TIMEOUT";
+    constexpr char DropDisplayVariable[]    = "WAYLAND_SYSTEMD_ASKPASS_DROP_DISPLAY";
+    constexpr char MetricsVariable[]        = "WAYLAND_SYSTEMD_ASKPASS_METRICS";
+    constexpr char MetricsSocketName[]      = "wayland-systemd-askpass-metrics.socket";
+    constexpr char RequestSocketVariable[]  = "WAYLAND_SYSTEMD_ASKPASS_REQUEST_SOCKET";
+    constexpr char RequestSocketName[]      = "wayland-systemd-askpass.socket";
 
     std::string_view get_xdg_runtime_dir() {
-        return getenv(XdgRuntimeDirVariable);
+        const char *runtime_dir = getenv(XdgRuntimeDirVariable);
+        return runtime_dir != nullptr ? runtime_dir : "";
+    }
+
+    bool is_variable_set(const char *name, std::string_view value) {
+        const char *variable = getenv(name);
+        return variable != nullptr && variable == value;
+    }
+
+    std::optional<unsigned int> get_unsigned_variable(const char *name) {
+        const char *variable = getenv(name);
+        if (variable == nullptr) {
+            return {};
+        }
+        std::string_view value = variable;
+        unsigned int result    = 0;
+        auto [ptr, ec]         = std::from_chars(value.data(), value.data() + value.size(), result);
+        if (ec != std::errc {} || ptr != value.data() + value.size()) {
+            return {};
+        }
+        return result;
+    }
+
+    // Connects to a unix socket, a leading '@' names an abstract one
+    bool can_connect(std::string_view path) {
+        sockaddr_un addr {};
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            return false;
+        }
+        std::memcpy(addr.sun_path, path.data(), path.size());
+        socklen_t length = sizeof(addr);
+        if (path.front() == '@') {
+            addr.sun_path[0] = '\0';
+            length           = offsetof(sockaddr_un, sun_path) + path.size();
+        }
+        wrapper::unique_fd fd {socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+        return fd.get() >= 0 && connect(fd.get(), reinterpret_cast<const sockaddr *>(&addr), length) == 0;
+    }
+
+    // Where wl_display_connect looks, with wayland-0 if the variable wasn't imported yet
+    bool has_wayland_display() {
+        const char *variable = getenv(WaylandDisplayVariable);
+        std::filesystem::path path = variable != nullptr ? variable : "wayland-0";
+        if (path.is_relative()) {
+            if (get_xdg_runtime_dir().empty()) {
+                return false;
+            }
+            path = std::filesystem::path(get_xdg_runtime_dir()) / path;
+        }
+        return can_connect(path.native());
+    }
+
+    // Only local displays (":N" or ":N.S") are probed, remote ones are left to Xlib
+    bool has_x11_display() {
+        const char *variable = getenv(X11DisplayVariable);
+        if (variable == nullptr) {
+            return false;
+        }
+        std::string_view display = variable;
+        if (!display.starts_with(':')) {
+            return true;
+        }
+        std::string_view number = display.substr(1, display.find('.') - 1);
+        std::string path        = std::string("/tmp/.X11-unix/X").append(number);
+        return can_connect('@' + path) || can_connect(path);
+    }
+
+    // Probing the sockets is much cheaper than letting GTK fail, and checks more than the
+    // environment, which a service started before the compositor may not have yet
+    bool has_display() {
+        return has_wayland_display() || has_x11_display();
+    }
+
+    // Seconds without requests after which the daemon exits, zero if it stays resident
+    unsigned int get_idle_exit_period() {
+        return get_unsigned_variable(IdleExitVariable).value_or(0);
+    }
+
+    // With WAYLAND_SYSTEMD_ASKPASS_METRICS=1 the metrics are served in $XDG_RUNTIME_DIR, which
+    // only the user can access
+    void open_metrics_endpoint(std::optional<Askpass::MetricsEndpoint> &endpoint) {
+        if (!is_variable_set(MetricsVariable, "1")) {
+            return;
+        }
+        try {
+            endpoint.emplace(std::filesystem::path(get_xdg_runtime_dir()) / MetricsSocketName);
+        } catch (const std::system_error &ex) {
+            std::cerr << "Failed to open the metrics socket: " << ex.what() << '\n';
+        }
+    }
+
+    // With WAYLAND_SYSTEMD_ASKPASS_REQUEST_SOCKET=1 requests are also taken on a socket in
+    // $XDG_RUNTIME_DIR, so only the user's own processes can connect
+    template<class Model>
+    void open_request_socket(std::optional<Askpass::RequestSocket> &request_socket, Model &model) {
+        if (!is_variable_set(RequestSocketVariable, "1")) {
+            return;
+        }
+        try {
+            request_socket.emplace(std::filesystem::path(get_xdg_runtime_dir()) / RequestSocketName);
+        } catch (const std::system_error &ex) {
+            std::cerr << "Failed to open the request socket: " << ex.what() << '\n';
+            return;
+        }
+        // Answers go to connected sockets, whose clients may have hung up in the meantime
+        signal(SIGPIPE, SIG_IGN);
+        request_socket->signal_request().connect(
+            [&model](std::unique_ptr<Askpass::SystemdAskpassContext> &context) {
+                model.on_request_received(std::move(context));
+            });
+    }
+
+    Askpass::ModelConfig get_model_config() {
+        Askpass::ModelConfig config {};
+        // "fifo" shows requests in arrival order, by default the one closest to its NotAfter comes first
+        if (is_variable_set(QueuePolicyVariable, "fifo")) {
+            config.queue_policy = Askpass::QueuePolicy::Fifo;
+        }
+        config.batch_requests = is_variable_set(BatchVariable, "1");
+        config.cache_timeout  = get_unsigned_variable(CacheTimeoutVariable).value_or(Askpass::DefaultCacheTimeout);
+        return config;
     }
 }; // namespace
 
 class UiManager : public sigc::trackable {
     Glib::RefPtr<Gtk::Application> m_application;
     sigc::signal<void(void)> m_window_closed_signal {};
-    Gtk::Window *m_open_window {};
+    // A single window is kept realized and re-bound to each request.
+    std::unique_ptr<Askpass::Window> m_window {};
+    bool m_window_open {false};
+    // Closes the display connection whenever no window is open, dropping the renderer, fonts and
+    // surfaces along with it, and opens it again for the next request. On Wayland gtk4-layer-shell
+    // stays bound to the first display, so only the window is destroyed there.
+    bool m_drop_display;
+    bool m_display_closed {false};
+    Askpass::DeadlineTimer m_deadline_timer {};
+#ifdef ASKPASS_USDT
+    std::vector<std::uint64_t> m_unpainted_requests {};
+    sigc::scoped_connection m_after_paint {};
+
+    void on_after_paint() {
+        for (std::uint64_t request_id : m_unpainted_requests) {
+            ASKPASS_TRACE(first_frame, request_id);
+        }
+        m_unpainted_requests.clear();
+        m_after_paint.disconnect();
+    }
+
+    // Reports the first frame painted after the window was shown
+    void trace_first_frame(const Askpass::WindowModel &model) {
+        for (std::size_t i = 0; i < model.size(); ++i) {
+            ASKPASS_TRACE(window_spawned, model.context(i).request_id());
+            m_unpainted_requests.push_back(model.context(i).request_id());
+        }
+        if (auto frame_clock = m_window->get_frame_clock(); frame_clock && !m_after_paint.connected()) {
+            m_after_paint = frame_clock->signal_after_paint().connect(sigc::mem_fun(*this, &UiManager::on_after_paint));
+        }
+    }
+#endif
 
     void emit_signal_window_closed() {
-        m_open_window = nullptr;
+        m_window_open = false;
         m_window_closed_signal.emit();
+        if (m_drop_display && !m_window_open) {
+            release_display();
+        }
+    }
+
+    void on_window_hidden() {
+        // Don't re-present the window from inside its own hide handler
+        Glib::signal_idle().connect_once(sigc::mem_fun(*this, &UiManager::emit_signal_window_closed));
+    }
+
+    void prepare_window() {
+        m_window = std::make_unique<Askpass::Window>(std::string_view {});
+        m_window->set_hide_on_close(true);
+        m_window->signal_hide().connect(sigc::mem_fun(*this, &UiManager::on_window_hidden));
+        m_application->add_window(*m_window);
+        m_window->realize();
+    }
+
+    void on_startup() {
+        if (m_drop_display) {
+            release_display();
+            if (!m_display_closed) {
+                std::cerr << "Only X11 displays can be closed, keeping the display open\n";
+            }
+        } else {
+            prepare_window();
+        }
+    }
+
+    void release_display() {
+        if (m_window) {
+            m_application->remove_window(*m_window);
+            m_window.reset();
+        }
+        auto display = Gdk::Display::get_default();
+        if (!display || G_OBJECT_TYPE_NAME(display->gobj()) != std::string_view("GdkX11Display")) {
+            return;
+        }
+        display->close();
+        m_display_closed = true;
+        Askpass::mark_phase("display_closed");
+    }
+
+    void reconnect_display() {
+        // Gdk::Display::open can't pass NULL, which selects the display from the environment
+        GdkDisplay *display = gdk_display_open(nullptr);
+        if (display == nullptr) {
+            std::cerr << "Failed to reconnect to the display\n";
+            exit(Askpass::ExitCode::InvalidPlatform);
+        }
+        gdk_display_manager_set_default_display(gdk_display_manager_get(), display);
+        m_display_closed = false;
+        Askpass::mark_phase("display_reconnected");
     }
 
 public:
-    UiManager() : m_application(Gtk::Application::create(std::string(AppId))) {}
+    explicit UiManager(bool drop_display) :
+            m_application(Gtk::Application::create(std::string(AppId), Askpass::application_flags())),
+            m_drop_display(drop_display) {
+        Askpass::mark_application_phases(m_application);
+        m_application->signal_startup().connect(sigc::mem_fun(*this, &UiManager::on_startup));
+    }
 
     sigc::signal<void(void)> signal_window_closed() noexcept { return m_window_closed_signal; }
 
     void spawn_window(Askpass::WindowModel &model) {
-        assert(m_open_window == nullptr);
-        auto window = Gtk::make_managed<Askpass::Window>(model);
-        window->signal_unrealize().connect(sigc::mem_fun(*this, &UiManager::emit_signal_window_closed));
-        m_open_window = window;
-        m_application->add_window(*window);
-        window->present();
+        assert(!m_window_open);
+        if (m_display_closed) {
+            reconnect_display();
+        }
+        if (!m_window) {
+            prepare_window();
+        }
+        m_window->bind(model);
+        m_window_open = true;
+        m_window->present();
+#ifdef ASKPASS_USDT
+        trace_first_frame(model);
+#endif
+    }
+
+    void update_window(Askpass::WindowModel &model) {
+        m_window->set_message(model.message());
     }
 
     void close_window() {
-        m_open_window->close();
+        m_window->close();
+    }
+
+    time_t now() const { return g_get_monotonic_time(); }
+
+    sigc::connection set_deadline(time_t deadline, const sigc::slot<void()> &func) {
+        return m_deadline_timer.arm(deadline, func);
     }
 
-    sigc::connection set_timeout(unsigned int milliseconds, const sigc::slot<bool()> &func) {
-        return Glib::signal_timeout().connect(func, milliseconds);
+    sigc::connection watch_process(int pid, const sigc::slot<void()> &func) {
+        return Askpass::watch_process(pid, func);
     }
 
     int run(int argc, char *argv[]) {
@@ -54,40 +319,124 @@ public:
     }
 
     void stop() { m_application->release(); }
+
+    void quit() { m_application->quit(); }
 };
 
 static_assert(Askpass::UiInterface<UiManager>);
 
-auto get_askpass_directory_gio_file() {
+auto get_askpass_directory_paths() {
     std::filesystem::path runtime_dir = get_xdg_runtime_dir();
     if (runtime_dir.empty()) {
         exit(Askpass::ExitCode::RuntimeDirectoryUnset);
     }
-    runtime_dir /= "systemd/ask-password";
 
-    return Gio::File::create_for_path(runtime_dir.native());
+    return std::array {runtime_dir, runtime_dir / "systemd", runtime_dir / "systemd/ask-password"};
 }
 
+template<Askpass::UiInterface Ui>
 class AskpassDirectorMonitor : public sigc::trackable {
-    Askpass::Model<UiManager> &m_model;
-    Glib::RefPtr<Gio::File> m_askpass_directory;
-    Glib::RefPtr<Gio::FileMonitor> m_file_monitor;
-    bool m_directory_enumerated {false};
+    // Watched directories, from $XDG_RUNTIME_DIR down to the ask-password directory. The runtime
+    // directory is only watched while the systemd directory does not exist.
+    enum Levels { LEVEL_RUNTIME_DIR, LEVEL_PARENT, LEVEL_ASKPASS_DIR, LEVEL_MAX };
+
+    static constexpr uint32_t ParentMask = IN_CREATE | IN_MOVED_TO | IN_ONLYDIR;
+    static constexpr uint32_t AskpassDirectoryMask
+        = IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | IN_MOVE_SELF | IN_ONLYDIR;
+
+    Askpass::Model<Ui> &m_model;
+    std::array<std::filesystem::path, LEVEL_MAX> m_paths;
+    std::array<int, LEVEL_MAX> m_watches {-1, -1, -1};
+    wrapper::unique_fd m_inotify_fd;
+    std::shared_ptr<const wrapper::unique_fd> m_directory_fd {};
+    sigc::scoped_connection m_io_watch {};
     bool m_idle_signal_installed {false};
+    std::uint64_t m_next_request_id {1};
+
+    static bool is_askpass_file_name(std::string_view name) { return name.starts_with("ask."); }
+
+    Askpass::AskpassFile make_askpass_file(std::string name, std::uint64_t request_id = 0) {
+        return {m_directory_fd, std::move(name), request_id};
+    }
+
+    void on_file_created(std::string_view name) {
+        std::uint64_t request_id = m_next_request_id++;
+        ASKPASS_TRACE(file_event, request_id, name.data());
+        m_model.on_file_created(make_askpass_file(std::string(name), request_id));
+    }
+
+    void remove_watch(Levels level) {
+        if (m_watches[level] >= 0) {
+            inotify_rm_watch(m_inotify_fd.get(), m_watches[level]);
+            m_watches[level] = -1;
+        }
+        if (level == LEVEL_ASKPASS_DIR) {
+            m_directory_fd.reset();
+        }
+    }
+
+    int add_watch(Levels level) {
+        auto mask = level == LEVEL_ASKPASS_DIR ? AskpassDirectoryMask : ParentMask;
+        return m_watches[level] = inotify_add_watch(m_inotify_fd.get(), m_paths[level].c_str(), mask);
+    }
+
+    void add_watches() {
+        if (m_watches[LEVEL_PARENT] < 0) {
+            if (add_watch(LEVEL_PARENT) < 0) {
+                if (m_watches[LEVEL_RUNTIME_DIR] < 0) {
+                    add_watch(LEVEL_RUNTIME_DIR);
+                }
+                return;
+            }
+            remove_watch(LEVEL_RUNTIME_DIR);
+        }
+
+        if (m_watches[LEVEL_ASKPASS_DIR] < 0 && add_watch(LEVEL_ASKPASS_DIR) >= 0) {
+            m_directory_fd = std::make_shared<const wrapper::unique_fd>(
+                open(m_paths[LEVEL_ASKPASS_DIR].c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC));
+            enumerate_directory();
+        }
+    }
 
     void enumerate_directory() {
-        auto enumerator = m_askpass_directory->enumerate_children(
-            G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_STANDARD_TYPE);
-        for (auto file = enumerator->next_file(); file; file = enumerator->next_file()) {
-            if (file->get_file_type() == Gio::FileType::REGULAR && file->get_name().starts_with("ask.")) {
-                m_model.on_file_created(enumerator->get_child(file));
+        std::unique_ptr<DIR, decltype(&closedir)> dir {opendir(m_paths[LEVEL_ASKPASS_DIR].c_str()), &closedir};
+        if (!dir) {
+            return;
+        }
+        while (const dirent *entry = readdir(dir.get())) {
+            std::string_view name = entry->d_name;
+            if (!is_askpass_file_name(name)) {
+                continue;
+            }
+            bool is_regular = entry->d_type == DT_REG;
+            if (struct stat buffer {}; entry->d_type == DT_UNKNOWN
+                && fstatat(dirfd(dir.get()), entry->d_name, &buffer, AT_SYMLINK_NOFOLLOW) == 0) {
+                is_regular = S_ISREG(buffer.st_mode);
+            }
+            if (is_regular) {
+                on_file_created(name);
             }
         }
+    }
 
-        enqueue_events_ended_signal();
-        m_directory_enumerated = true;
+public:
+    // Whether the ask-password directory is missing or holds no entries at all. Any entry would
+    // make the path unit start the daemon again right away.
+    bool is_directory_empty() const {
+        std::unique_ptr<DIR, decltype(&closedir)> dir {opendir(m_paths[LEVEL_ASKPASS_DIR].c_str()), &closedir};
+        if (!dir) {
+            return errno == ENOENT;
+        }
+        while (const dirent *entry = readdir(dir.get())) {
+            std::string_view name = entry->d_name;
+            if (name != "." && name != "..") {
+                return false;
+            }
+        }
+        return true;
     }
 
+private:
     void events_ended_signal() {
         m_model.on_file_events_ended();
         m_idle_signal_installed = false;
@@ -100,47 +449,130 @@ class AskpassDirectorMonitor : public sigc::trackable {
         }
     }
 
-    void on_signal_changed(const Glib::RefPtr<Gio::File> &file, const Glib::RefPtr<Gio::File> &,
-        Gio::FileMonitor::Event event) {
-        // Gio::FileMonitor behaves weirdly when the directory does not exists.
-        // We can't know if this event is caused by the ask-password directory or an ask-password file in the directory
-        assert(file);
-        auto file_name = file->get_basename();
-        if (file_name == "ask-password") {
-            if (!m_directory_enumerated && event == Gio::FileMonitor::Event::CREATED) {
+    void on_watch_removed(int wd) {
+        for (int level = LEVEL_RUNTIME_DIR; level < LEVEL_MAX; ++level) {
+            if (m_watches[level] == wd) {
+                remove_watch(static_cast<Levels>(level));
+                add_watches();
+                return;
+            }
+        }
+    }
+
+    void on_event(const inotify_event &event) {
+        std::string_view name = event.len > 0 ? event.name : "";
+        if (event.mask & IN_Q_OVERFLOW) {
+            // Deleted files we missed are dropped by the model once reading them fails
+            if (m_watches[LEVEL_ASKPASS_DIR] >= 0) {
                 enumerate_directory();
-            } else if (event == Gio::FileMonitor::Event::DELETED) {
-                m_directory_enumerated = false;
             }
-        } else if (file_name.starts_with("ask.")) {
-            if (event == Gio::FileMonitor::Event::CREATED) {
-                m_model.on_file_created(file);
-                enqueue_events_ended_signal();
-            } else if (event == Gio::FileMonitor::Event::DELETED) {
-                m_model.on_file_deleted(file);
+        } else if (event.mask & IN_IGNORED) {
+            on_watch_removed(event.wd);
+        } else if (event.mask & IN_MOVE_SELF) {
+            // A moved directory keeps its watch, but it is not at our path anymore
+            inotify_rm_watch(m_inotify_fd.get(), event.wd);
+        } else if (event.wd == m_watches[LEVEL_ASKPASS_DIR]) {
+            if (!is_askpass_file_name(name) || (event.mask & IN_ISDIR)) {
+                return;
+            }
+            // Only complete files count. systemd renames ask files into place once they are written.
+            if (event.mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                on_file_created(name);
+            } else if (event.mask & (IN_DELETE | IN_MOVED_FROM)) {
+                m_model.on_file_deleted(make_askpass_file(std::string(name)));
+            }
+        } else if (event.wd == m_watches[LEVEL_PARENT] || event.wd == m_watches[LEVEL_RUNTIME_DIR]) {
+            add_watches();
+        }
+    }
+
+    bool on_inotify_io(Glib::IOCondition) {
+        alignas(inotify_event) char buffer[4096];
+        for (;;) {
+            ssize_t length = read(m_inotify_fd.get(), buffer, sizeof(buffer));
+            if (length < 0 && errno == EINTR) {
+                continue;
+            } else if (length <= 0) {
+                break;
+            }
+            for (char *ptr = buffer; ptr < buffer + length;) {
+                const auto *event = reinterpret_cast<const inotify_event *>(ptr);
+                on_event(*event);
+                ptr += sizeof(inotify_event) + event->len;
             }
         }
+        // One pass over the model for the whole batch
+        m_model.on_file_events_ended();
+        return true;
     }
 
 public:
-    AskpassDirectorMonitor(Askpass::Model<UiManager> &model) :
-            m_model(model), m_askpass_directory(get_askpass_directory_gio_file()),
-            m_file_monitor(m_askpass_directory->monitor_directory()) {
-        m_file_monitor->signal_changed().connect(sigc::mem_fun(*this, &AskpassDirectorMonitor::on_signal_changed));
-        enumerate_directory();
+    AskpassDirectorMonitor(Askpass::Model<Ui> &model) :
+            m_model(model), m_paths(get_askpass_directory_paths()),
+            m_inotify_fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {
+        throw_system_error_if(m_inotify_fd.get() < 0);
+        m_io_watch = Glib::signal_io().connect(
+            sigc::mem_fun(*this, &AskpassDirectorMonitor::on_inotify_io), m_inotify_fd.get(), Glib::IOCondition::IO_IN);
+        add_watches();
+        enqueue_events_ended_signal();
     }
 };
 
-int main(int argc, char **argv) {
-    UiManager ui_manager {};
-    Askpass::Model model {ui_manager};
-    AskpassDirectorMonitor monitor {model};
+// Quits once the daemon was idle for a whole period. The shipped path unit (DirectoryNotEmpty=)
+// starts it again for the next request. Requests are backed by their ask files, so nothing has to
+// survive the restart.
+template<Askpass::UiInterface Ui>
+class IdleExit : public sigc::trackable {
+    Ui &m_ui_manager;
+    const Askpass::Model<Ui> &m_model;
+    const AskpassDirectorMonitor<Ui> &m_monitor;
+    time_t m_period;
+    time_t m_idle_since;
+    sigc::scoped_connection m_timer {};
+
+    bool on_tick() {
+        time_t now = m_ui_manager.now();
+        if (!m_model.is_idle() || !m_monitor.is_directory_empty()) {
+            m_idle_since = now;
+        } else if (now - m_idle_since >= m_period) {
+            m_ui_manager.quit();
+            return false;
+        }
+        return true;
+    }
+
+public:
+    IdleExit(Ui &ui_manager, const Askpass::Model<Ui> &model, const AskpassDirectorMonitor<Ui> &monitor,
+        unsigned int seconds) :
+            m_ui_manager(ui_manager), m_model(model), m_monitor(monitor), m_period(time_t(seconds) * 1000000),
+            m_idle_since(ui_manager.now()) {
+        // Checking a few times per period keeps the exit close to the configured delay
+        unsigned int interval = std::max(seconds / 4, 1u);
+        m_timer = Glib::signal_timeout().connect_seconds(sigc::mem_fun(*this, &IdleExit::on_tick), interval);
+    }
+};
+
+template<Askpass::UiInterface Ui>
+int run_agent(Ui &ui_manager, int argc, char **argv) {
+    Askpass::Model model {ui_manager, get_model_config()};
+    AskpassDirectorMonitor<Ui> monitor {model};
+    std::optional<Askpass::MetricsEndpoint> metrics_endpoint {};
+    open_metrics_endpoint(metrics_endpoint);
+    std::optional<Askpass::RequestSocket> request_socket {};
+    open_request_socket(request_socket, model);
+    std::optional<IdleExit<Ui>> idle_exit {};
+    if (unsigned int seconds = get_idle_exit_period(); seconds != 0 && request_socket) {
+        // Nothing starts the daemon again for a connecting client, which would be refused instead
+        std::cerr << "Not exiting when idle while the request socket is open\n";
+    } else if (seconds != 0) {
+        idle_exit.emplace(ui_manager, model, monitor, seconds);
+    }
 
     // Don't need to remove it since ui_manager is alive while the MainLoop runs
     g_unix_signal_add(
         SIGTERM,
         [](gpointer user_data) -> gboolean {
-            auto ui_manager = static_cast<UiManager *>(user_data);
+            auto ui_manager = static_cast<Ui *>(user_data);
             ui_manager->stop();
             return false;
         },
@@ -148,3 +580,20 @@ int main(int argc, char **argv) {
 
     return ui_manager.run(argc, argv);
 }
+
+int main(int argc, char **argv) {
+    Askpass::mark_phase("main");
+    if (!has_display()) {
+        // Prompt on the terminal without ever initializing GTK
+        Glib::init();
+        Askpass::ConsoleUi console_ui {};
+        if (!console_ui.has_terminal()) {
+            std::cerr << "Neither a display nor a terminal is available\n";
+            Askpass::exit(Askpass::ExitCode::InvalidPlatform);
+        }
+        return run_agent(console_ui, argc, argv);
+    }
+
+    UiManager ui_manager {is_variable_set(DropDisplayVariable, "1")};
+    return run_agent(ui_manager, argc, argv);
+}
@@ -0,0 +1,26 @@
+#include "metrics-endpoint.h"
+
+#include <string>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+namespace Askpass {
+    MetricsEndpoint::MetricsEndpoint(std::filesystem::path path) :
+            m_path(std::move(path)),
+            m_listener(listen_unix_socket(m_path, SOCK_STREAM), SOCK_NONBLOCK,
+                sigc::mem_fun(*this, &MetricsEndpoint::on_accepted)) {}
+
+    MetricsEndpoint::~MetricsEndpoint() {
+        unlink(m_path.c_str());
+    }
+
+    void MetricsEndpoint::on_accepted(wrapper::unique_fd &connection) {
+        // A few KiB, which fit into the socket buffer of a fresh connection. The main loop never
+        // waits for a scraper, one that can't take it all at once gets a truncated reply.
+        const std::string text = metrics().format();
+        send(connection.get(), text.data(), text.size(), MSG_NOSIGNAL);
+    }
+} // namespace Askpass
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace {
+    constexpr std::array<std::string_view, static_cast<std::size_t>(Askpass::RequestEvent::Max)> RequestEventNames {
+        "seen", "parsed", "rejected", "expired", "orphaned", "answered", "cancelled"};
+
+    // Seconds with microsecond precision, e.g. "0.250000"
+    std::string format_seconds(std::uint64_t microseconds) {
+        std::string fraction = std::to_string(microseconds % 1000000);
+        return std::to_string(microseconds / 1000000) + '.' + std::string(6 - fraction.size(), '0') + fraction;
+    }
+
+    void append_sample(std::string &output, std::string_view name, std::string_view labels, std::string_view value) {
+        output.append(name);
+        if (!labels.empty()) {
+            output.append("{").append(labels).append("}");
+        }
+        output.append(" ").append(value).append("\n");
+    }
+
+    void append_type(std::string &output, std::string_view name, std::string_view help, std::string_view type) {
+        output.append("# HELP ").append(name).append(" ").append(help).append("\n");
+        output.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+    }
+
+    void append_gauge(std::string &output, std::string_view name, std::string_view help,
+        const std::atomic<std::uint64_t> &value) {
+        append_type(output, name, help, "gauge");
+        append_sample(output, name, {}, std::to_string(value.load(std::memory_order_relaxed)));
+    }
+} // namespace
+
+namespace Askpass {
+    void LatencyHistogram::observe(time_t microseconds) noexcept {
+        microseconds = std::max<time_t>(microseconds, 0);
+        auto bucket  = std::lower_bound(LatencyBuckets.begin(), LatencyBuckets.end(), microseconds);
+        m_buckets[bucket - LatencyBuckets.begin()].fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(static_cast<std::uint64_t>(microseconds), std::memory_order_relaxed);
+    }
+
+    void LatencyHistogram::format(std::string &output, std::string_view name) const {
+        const std::string bucket_name = std::string(name) + "_bucket";
+        std::uint64_t count           = 0;
+        for (std::size_t i = 0; i < m_buckets.size(); ++i) {
+            count += m_buckets[i].load(std::memory_order_relaxed);
+            std::string bound = i < LatencyBuckets.size() ? format_seconds(LatencyBuckets[i]) : "+Inf";
+            append_sample(output, bucket_name, "le=\"" + bound + "\"", std::to_string(count));
+        }
+        append_sample(output, std::string(name) + "_sum", {}, format_seconds(m_sum.load(std::memory_order_relaxed)));
+        append_sample(output, std::string(name) + "_count", {}, std::to_string(count));
+    }
+
+    void Metrics::count(RequestEvent event, std::uint64_t requests) noexcept {
+        this->requests[static_cast<std::size_t>(event)].fetch_add(requests, std::memory_order_relaxed);
+    }
+
+    std::string Metrics::format() const {
+        std::string output;
+
+        constexpr std::string_view RequestsName = "askpass_requests_total";
+        append_type(output, RequestsName, "Ask files by what happened to them", "counter");
+        for (std::size_t i = 0; i < requests.size(); ++i) {
+            append_sample(output,
+                RequestsName,
+                "event=\"" + std::string(RequestEventNames[i]) + "\"",
+                std::to_string(requests[i].load(std::memory_order_relaxed)));
+        }
+
+        append_gauge(output, "askpass_requests_queued", "Requests waiting for a window", queued);
+        append_gauge(output, "askpass_requests_prefetching", "Ask files being read", prefetching);
+        append_gauge(output, "askpass_requests_shown", "Requests answered by the open window", shown);
+        append_gauge(output, "askpass_windows_writing", "Closed windows whose answers are being written", writing);
+
+        constexpr std::string_view EventToWindowName = "askpass_event_to_window_seconds";
+        append_type(output, EventToWindowName, "Time from the ask file's event to showing the request", "histogram");
+        event_to_window.format(output, EventToWindowName);
+
+        constexpr std::string_view WindowToAnswerName = "askpass_window_to_answer_seconds";
+        append_type(output, WindowToAnswerName, "Time from showing a window to its answer or cancellation", "histogram");
+        window_to_answer.format(output, WindowToAnswerName);
+
+        return output;
+    }
+
+    Metrics &metrics() noexcept {
+        static Metrics instance {};
+        return instance;
+    }
+} // namespace Askpass
\ No newline at end of file
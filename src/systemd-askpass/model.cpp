@@ -1,49 +1,78 @@
 #include "model.h"
 
+#include <array>
 #include <cassert>
-#include <sstream>
+#include <cerrno>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "macros.h"
+#include "tracing.h"
 
 namespace {
-    std::string read_gio_file(Gio::File &file) {
-        auto input_stream = file.read();
-        auto size_hint    = file.query_info(G_FILE_ATTRIBUTE_STANDARD_SIZE)->get_size();
-
-        std::string buffer {};
-        buffer.resize(size_hint + 1);
-
-        gssize bytes_read = input_stream->read(buffer.data(), buffer.size());
-        abort_if(bytes_read < 0);
-
-        // File size changed. Unlucky :(
-        constexpr size_t SizeIncreaseOnReadNotEOF = 256;
-        while (gsize(bytes_read) == buffer.size()) {
-            buffer.resize(buffer.size() + SizeIncreaseOnReadNotEOF);
-            gssize read = input_stream->read(buffer.data() + bytes_read, SizeIncreaseOnReadNotEOF);
-            abort_if(read < 0);
-            bytes_read += read;
+    // Ask files are a few hundred bytes, so they are usually read with a single read(2)
+    constexpr std::size_t StackBufferSize = 4096;
+
+    std::size_t read_into(int fd, std::span<char> buffer) {
+        std::size_t bytes_read = 0;
+        while (bytes_read < buffer.size()) {
+            ssize_t res = read(fd, buffer.data() + bytes_read, buffer.size() - bytes_read);
+            if (res < 0 && errno == EINTR) {
+                continue;
+            }
+            throw_system_error_if(res < 0);
+            if (res == 0) {
+                break;
+            }
+            bytes_read += res;
+        }
+        return bytes_read;
+    }
+
+    template<class Func>
+    auto with_file_contents(int fd, Func &&func) {
+        std::array<char, StackBufferSize> stack_buffer;
+        std::size_t bytes_read = read_into(fd, stack_buffer);
+        if (bytes_read < stack_buffer.size()) {
+            return func(std::string_view(stack_buffer.data(), bytes_read));
         }
 
-        buffer.resize(bytes_read);
-        return buffer;
+        // Large file or it grew while we read it. Continue on the heap until EOF.
+        std::string heap_buffer(stack_buffer.data(), bytes_read);
+        do {
+            heap_buffer.resize(heap_buffer.size() * 2);
+            bytes_read += read_into(fd, std::span(heap_buffer).subspan(bytes_read));
+        } while (bytes_read == heap_buffer.size());
+        heap_buffer.resize(bytes_read);
+        return func(std::string_view(heap_buffer));
     }
 } // namespace
 
 namespace Askpass::detail {
-    AskpassFileImpl::AskpassFileImpl(Glib::RefPtr<Gio::File> pfile) : file(pfile) {}
+    AskpassFileImpl::AskpassFileImpl(
+        std::shared_ptr<const wrapper::unique_fd> directory, std::string name, std::uint64_t request_id) :
+            directory(std::move(directory)), name(std::move(name)), request_id(request_id) {}
 
     bool operator==(const AskpassFileImpl &lhs, const AskpassFileImpl &rhs) noexcept {
-        return lhs.file->equal(rhs.file);
+        return lhs.name == rhs.name;
     }
 
     std::unique_ptr<Askpass::SystemdAskpassContext> read_askpass_file(const AskpassFileImpl &file) {
-        std::istringstream istream {read_gio_file(*file.file)};
-        return Askpass::SystemdAskpassContext::from_askpass_file(istream);
+        wrapper::unique_fd fd {
+            openat(file.directory->get(), file.name.c_str(), O_RDONLY | O_NOFOLLOW | O_NOCTTY | O_CLOEXEC)};
+        throw_system_error_if(fd.get() < 0);
+        return with_file_contents(fd.get(), [&](std::string_view contents) {
+            ASKPASS_TRACE(file_read, file.request_id);
+            return Askpass::SystemdAskpassContext::from_askpass_file(contents, file.request_id);
+        });
     }
 } // namespace Askpass::detail
 
-guint std::hash<Askpass::detail::AskpassFileImpl>::operator()(
+std::size_t std::hash<Askpass::detail::AskpassFileImpl>::operator()(
     const Askpass::detail::AskpassFileImpl &file) const noexcept {
-    return file.file->hash();
+    return std::hash<std::string>()(file.name);
 };
\ No newline at end of file
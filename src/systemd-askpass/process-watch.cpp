@@ -0,0 +1,33 @@
+#include "process-watch.h"
+
+#include <cerrno>
+
+#include <glibmm.h>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Askpass {
+    sigc::connection watch_process(int pid, const sigc::slot<void()> &func) {
+        int pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+        if (pidfd < 0 && errno == ESRCH) {
+            return Glib::signal_idle().connect([func]() {
+                func();
+                return false;
+            });
+        } else if (pidfd < 0) {
+            return {};
+        }
+
+        // The source owns the channel, which closes the pidfd when the watch is disconnected
+        auto channel = Glib::IOChannel::create_from_fd(pidfd);
+        channel->set_close_on_unref(true);
+        return Glib::signal_io().connect(
+            [func](Glib::IOCondition) {
+                func();
+                return false;
+            },
+            channel,
+            Glib::IOCondition::IO_IN);
+    }
+} // namespace Askpass
\ No newline at end of file
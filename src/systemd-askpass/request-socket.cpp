@@ -0,0 +1,87 @@
+#include "request-socket.h"
+
+#include <array>
+#include <cerrno>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "macros.h"
+#include "metrics.h"
+#include "tracing.h"
+
+namespace {
+    // Requests are as small as ask files, which are a few hundred bytes
+    constexpr std::size_t MaxRequestSize = 4096;
+
+    int get_peer_pid(int fd) {
+        ucred credentials {};
+        socklen_t length = sizeof(credentials);
+        throw_system_error_if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) < 0);
+        return credentials.pid;
+    }
+} // namespace
+
+namespace Askpass {
+    RequestSocket::RequestSocket(std::filesystem::path path) :
+            m_path(std::move(path)),
+            m_listener(listen_unix_socket(m_path, SOCK_SEQPACKET), SOCK_NONBLOCK,
+                sigc::mem_fun(*this, &RequestSocket::on_accepted)) {}
+
+    RequestSocket::~RequestSocket() {
+        unlink(m_path.c_str());
+    }
+
+    void RequestSocket::on_accepted(wrapper::unique_fd &fd) {
+        // The client may connect before it sends its request, so it is read once it arrives
+        auto connection   = m_pending.insert(m_pending.end(), pending_connection {std::move(fd)});
+        connection->watch = Glib::signal_io().connect(
+            [this, connection](Glib::IOCondition condition) { return on_connection_io(connection, condition); },
+            connection->fd.get(),
+            Glib::IOCondition::IO_IN | Glib::IOCondition::IO_HUP);
+    }
+
+    bool RequestSocket::on_connection_io(std::list<pending_connection>::iterator connection, Glib::IOCondition) {
+        std::array<char, MaxRequestSize> buffer;
+        ssize_t length = recv(connection->fd.get(), buffer.data(), buffer.size(), MSG_TRUNC);
+        if (length < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+
+        wrapper::unique_fd fd = std::move(connection->fd);
+        connection->watch.release();
+        m_pending.erase(connection);
+        if (length <= 0) {
+            return false;
+        }
+        if (static_cast<std::size_t>(length) > buffer.size()) {
+            std::cerr << "Askpass request is too large\n";
+            metrics().count(RequestEvent::Seen);
+            metrics().count(RequestEvent::Rejected);
+            return false;
+        }
+        receive_request(std::move(fd), std::string_view(buffer.data(), length));
+        return false;
+    }
+
+    void RequestSocket::receive_request(wrapper::unique_fd connection, std::string_view request) {
+        std::uint64_t request_id = m_next_request_id++;
+        ASKPASS_TRACE(file_event, request_id, m_path.c_str());
+        std::unique_ptr<SystemdAskpassContext> context;
+        try {
+            int pid = get_peer_pid(connection.get());
+            context = SystemdAskpassContext::from_request(request, std::move(connection), pid, request_id);
+        } catch (const std::runtime_error &ex) {
+            std::cerr << "Reading Askpass request failed:\n" << ex.what() << '\n';
+            metrics().count(RequestEvent::Seen);
+            metrics().count(RequestEvent::Rejected);
+            ASKPASS_TRACE(request_dropped, request_id);
+            return;
+        }
+        m_signal_request.emit(context);
+    }
+} // namespace Askpass
\ No newline at end of file
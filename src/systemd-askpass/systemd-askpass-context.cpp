@@ -1,34 +1,15 @@
 #include "systemd-askpass-context.h"
 
+#include <cstring>
 #include <span>
 
-#include <boost/program_options.hpp>
-
 #include <sys/socket.h>
 #include <sys/un.h>
 
 #include "macros.h"
-
-namespace po = boost::program_options;
+#include "tracing.h"
 
 namespace {
-    constexpr char OptionMessage[]  = "Ask.Message";
-    constexpr char OptionPID[]      = "Ask.PID";
-    constexpr char OptionSocket[]   = "Ask.Socket";
-    constexpr char OptionNotAfter[] = "Ask.NotAfter";
-
-    po::options_description create_option_description() {
-        // clang-format off
-        po::options_description desc {};
-        desc.add_options()
-            (OptionMessage , po::value<std::string>()->default_value("No message"), "Message to show")
-            (OptionPID     , po::value<int>()->required(), "PID of sender")
-            (OptionSocket  , po::value<std::string>()->required(), "The answer socket")
-            (OptionNotAfter, po::value<time_t>()->default_value(0), "The timeout");;
-        return desc;
-        // clang-format on
-    }
-
     template<size_t N, size_t M>
     void span_copy(std::span<char, N> dest, std::span<const char, M> src) {
         if (dest.size() < src.size()) {
@@ -58,21 +39,26 @@ namespace {
 
 namespace Askpass {
     SystemdAskpassContext::SystemdAskpassContext(
-        std::string m_message, int m_pid, wrapper::unique_fd m_answer_socket, time_t m_timeout) :
-            m_message(std::move(m_message)), m_pid(m_pid),
-            m_answer_socket(std::move(m_answer_socket)), m_timeout(m_timeout) {}
+        const AskFile &ask_file, wrapper::unique_fd m_answer_socket, std::uint64_t m_request_id) :
+            m_message(ask_file.message), m_id(ask_file.id), m_pid(ask_file.pid),
+            m_answer_socket(std::move(m_answer_socket)), m_timeout(ask_file.not_after), m_echo(ask_file.echo),
+            m_accept_cached(ask_file.accept_cached), m_request_id(m_request_id) {}
 
     std::unique_ptr<SystemdAskpassContext> SystemdAskpassContext::from_askpass_file(
-        std::basic_istream<char> &askpass_file) {
-        static const auto options = create_option_description();
-
-        po::variables_map vm;
-        po::store(po::parse_config_file(askpass_file, options, true), vm);
-        po::notify(vm);
+        std::string_view askpass_file, std::uint64_t request_id) {
+        const AskFile ask_file = parse_ask_file(askpass_file);
+        ASKPASS_TRACE(file_parsed, request_id);
+        wrapper::unique_fd answer_socket = create_answer_socket(ask_file.socket);
+        ASKPASS_TRACE(socket_connected, request_id);
+        return std::make_unique<SystemdAskpassContext>(ask_file, std::move(answer_socket), request_id);
+    }
 
-        return std::make_unique<SystemdAskpassContext>(std::move(vm.at(OptionMessage).as<std::string>()),
-            vm.at(OptionPID).as<int>(),
-            create_answer_socket(vm.at(OptionSocket).as<std::string>()),
-            vm.at(OptionNotAfter).as<time_t>());
+    std::unique_ptr<SystemdAskpassContext> SystemdAskpassContext::from_request(
+        std::string_view request, wrapper::unique_fd connection, int pid, std::uint64_t request_id) {
+        AskFile ask_file = parse_ask_request(request);
+        ASKPASS_TRACE(file_parsed, request_id);
+        // Unlike PID=, the peer's credentials can't be forged
+        ask_file.pid = pid;
+        return std::make_unique<SystemdAskpassContext>(ask_file, std::move(connection), request_id);
     }
 } // namespace Askpass
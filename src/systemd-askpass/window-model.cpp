@@ -1,47 +1,101 @@
 #include "window-model.h"
 
+#include <algorithm>
+#include <cerrno>
 #include <iostream>
-#include <span>
+#include <string>
 #include <string_view>
-#include <sys/socket.h>
-#include <sys/uio.h>
+#include <system_error>
 
 #include <sigc++/signal.h>
 
-#include "macros.h"
+#include "keyring.h"
+#include "metrics.h"
+#include "tracing.h"
 
-namespace {
-    void write_answer(int socket_fd, bool success, std::span<const std::byte> data) {
-        char is_successful_character = success ? '+' : '-';
-        std::array vecs              = {
-            iovec {&is_successful_character,             sizeof(is_successful_character)},
-            iovec {const_cast<std::byte *>(data.data()), data.size()                    }
-        };
+namespace Askpass {
+    void WindowModel::write_answers(char status, std::string_view input, ExitCode exit_status) {
+        m_answered            = true;
+        m_pending_exit_status = exit_status;
+        m_pending_writes      = m_contexts.size();
+        metrics().count(status == '+' ? RequestEvent::Answered : RequestEvent::Cancelled, m_contexts.size());
+        for (const auto &context : m_contexts) {
+            auto &sink = *m_sinks.emplace_back(std::make_unique<OutputSink>());
+            sink.signal_done().connect([this, request_id = context->request_id()](int error) {
+                on_answer_written(request_id, error);
+            });
+            sink.write(context->answer_socket(), {std::string_view(&status, 1), input});
+        }
+    }
 
-        ssize_t res = writev(socket_fd, vecs.data(), vecs.size());
-        throw_system_error_if(res < 0 && errno != ECONNREFUSED);
-        if (res < 0 && errno == ECONNREFUSED) {
+    void WindowModel::on_answer_written([[maybe_unused]] std::uint64_t request_id, int error) {
+        if (error == ECONNREFUSED) {
             std::cerr << "Answer socket already disappeared\n";
+        } else if (error != 0) {
+            std::cerr << "Failed to write answer: " << std::generic_category().message(error) << '\n';
+        }
+        ASKPASS_TRACE(answer_written, request_id);
+        if (--m_pending_writes == 0) {
+            m_exit_status = m_pending_exit_status;
+            // The handler may destroy this model, so nothing may follow the emission
+            m_signal_written.emit();
         }
     }
 
-    void write_answer(int socket_fd, bool success, std::string_view password) {
-        write_answer(socket_fd, success, std::as_bytes(std::span(password)));
+    void WindowModel::on_succeeded(std::string_view input) {
+        if (m_cache_timeout != 0) {
+            for (std::size_t i = 0; i < m_contexts.size(); ++i) {
+                const SystemdAskpassContext &context = *m_contexts[i];
+                bool cached_before = std::any_of(m_contexts.begin(), m_contexts.begin() + i,
+                    [&](const auto &other) { return other->accept_cached() && other->id() == context.id(); });
+                if (context.accept_cached() && !context.id().empty() && !cached_before) {
+                    store_cached_answer(context.id(), input, m_cache_timeout);
+                }
+            }
+        }
+        write_answers('+', input, ExitCode::Success);
     }
 
-} // namespace
-
-namespace Askpass {
-    void WindowModel::on_succeeded(std::string_view input) {
-        write_answer(m_context->answer_socket(), true, input);
-        m_exit_status = ExitCode::Success;
+    void WindowModel::answer_from_cache(std::string_view answer) {
+        write_answers('+', answer, ExitCode::Success);
     }
 
     void WindowModel::on_failure() {
-        write_answer(m_context->answer_socket(), false, std::string_view {});
-        m_exit_status = ExitCode::Cancelled;
+        write_answers('-', {}, ExitCode::Cancelled);
     }
 
-    WindowModel::WindowModel(std::unique_ptr<SystemdAskpassContext> context) :
-            m_context(std::move(context)) {}
+    void WindowModel::update_message() {
+        if (m_contexts.empty()) {
+            return;
+        }
+        m_message = m_contexts.front()->message();
+        if (m_contexts.size() > 1) {
+            m_message += " (" + std::to_string(m_contexts.size()) + " requests)";
+        }
+    }
+
+    WindowModel::WindowModel(std::unique_ptr<SystemdAskpassContext> context, unsigned int cache_timeout) :
+            m_cache_timeout(cache_timeout) {
+        add_context(std::move(context));
+    }
+
+    void WindowModel::add_context(std::unique_ptr<SystemdAskpassContext> context) {
+        m_contexts.push_back(std::move(context));
+        update_message();
+    }
+
+    void WindowModel::remove_context(std::size_t index) {
+        m_contexts.erase(m_contexts.begin() + index);
+        update_message();
+    }
+
+    time_t WindowModel::timeout() const noexcept {
+        time_t result = 0;
+        for (const auto &context : m_contexts) {
+            if (context->timeout() != 0 && (result == 0 || context->timeout() < result)) {
+                result = context->timeout();
+            }
+        }
+        return result;
+    }
 } // namespace Askpass
\ No newline at end of file
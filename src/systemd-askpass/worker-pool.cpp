@@ -0,0 +1,46 @@
+#include "worker-pool.h"
+
+#include <utility>
+
+namespace Askpass {
+    WorkerPool::WorkerPool(unsigned int thread_count) {
+        m_threads.reserve(thread_count);
+        for (unsigned int i = 0; i < thread_count; ++i) {
+            m_threads.emplace_back([this]() { run(); });
+        }
+    }
+
+    WorkerPool::~WorkerPool() {
+        {
+            std::lock_guard lock {m_mutex};
+            m_stopping = true;
+            m_jobs.clear();
+        }
+        m_condition.notify_all();
+        m_threads.clear();
+    }
+
+    void WorkerPool::submit(std::function<void()> job) {
+        {
+            std::lock_guard lock {m_mutex};
+            m_jobs.push_back(std::move(job));
+        }
+        m_condition.notify_one();
+    }
+
+    void WorkerPool::run() {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock lock {m_mutex};
+                m_condition.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+                if (m_stopping) {
+                    return;
+                }
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+            job();
+        }
+    }
+} // namespace Askpass
\ No newline at end of file